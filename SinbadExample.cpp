@@ -1,6 +1,10 @@
 #include "SinbadExample.hpp"
 #include "ssr_compositor.hpp"
 
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
 using namespace std;
 using namespace Ogre;
 
@@ -12,9 +16,81 @@ bool SinbadExample::keyPressed(const OgreBites::KeyboardEvent& evt) {
         getRoot()->queueEndRendering();
     }
 
+    // 1 to 6 switch between the full, temporal, half and quarter resolution raytrace, then the
+    // half and quarter resolution stochastic ones
+    if (evt.keysym.sym >= SDLK_1 && evt.keysym.sym < SDLK_1 + int(ssr_compositor::pipelines_count)) {
+        ssr.enable_pipelines(
+            *getRenderWindow()->getViewport(0),
+            Ogre::CompositorManager::getSingleton(),
+            size_t(evt.keysym.sym - SDLK_1)
+        );
+    }
+
+    // F1 to F4 switch between the low, medium, high and ultra raytrace quality
+    if (evt.keysym.sym >= SDLK_F1 && evt.keysym.sym < SDLK_F1 + int(ssr_compositor::quality_presets_count)) {
+        ssr.set_quality(
+            Ogre::CompositorManager::getSingleton(),
+            ssr_compositor::quality_presets[size_t(evt.keysym.sym - SDLK_F1)]
+        );
+    }
+
+    // P starts and stops streaming the ssr pass timings to a csv file
+    if (evt.keysym.sym == SDLK_p) {
+        if (ssr.profiler.csv.is_open()) {
+            ssr.profiler.close_csv();
+        } else {
+            ssr.profiler.open_csv("ssr_timings.csv");
+        }
+    }
+
+    // G lets the governor hold the raytrace to its budget, or hands the quality back to the F keys
+    if (evt.keysym.sym == SDLK_g) {
+        ssr.set_governor_enabled(!ssr.governor.enabled);
+    }
+
+    // C captures the raytrace inputs of the next frame for ssr_replay
+    if (evt.keysym.sym == SDLK_c) {
+        ssr.capture("ssr_capture_" + std::to_string(ssr.profiler.frame) + ".ssrcap");
+    }
+
     return true;
 }
 
+void SinbadExample::frameRendered(const Ogre::FrameEvent& evt) {
+    (void)evt;
+    ssr.profiler.frame_ended();
+    ssr.update_governor(Ogre::CompositorManager::getSingleton());
+
+    // one line per timed pass of the enabled pipeline: gpu then cpu min/avg/p99 in ms
+    const auto reports = ssr.profiler.reports();
+    Ogre::StringVector names{};
+    Ogre::StringVector values{};
+    for (const auto &report : reports) {
+        char value[96];
+        std::snprintf(
+            value,
+            sizeof(value),
+            "%.2f/%.2f/%.2f | %.2f/%.2f/%.2f",
+            report.gpu.min_ms, report.gpu.avg_ms, report.gpu.p99_ms,
+            report.cpu.min_ms, report.cpu.avg_ms, report.cpu.p99_ms
+        );
+        names.push_back(report.name.substr(report.name.rfind('/') + 1));
+        values.push_back(report.gpu_valid ? value : std::string("- | ") + std::strchr(value, '|') + 2);
+    }
+    if (mSSRStatsPanel == nullptr || mSSRStatsPanel->getAllParamNames() != names) {
+        if (mSSRStatsPanel != nullptr) {
+            mTrayMgr->destroyWidget(mSSRStatsPanel);
+            mSSRStatsPanel = nullptr;
+        }
+        if (!names.empty()) {
+            mSSRStatsPanel = mTrayMgr->createParamsPanel(OgreBites::TL_BOTTOMLEFT, "SSRStatsPanel", 360, names);
+        }
+    }
+    if (mSSRStatsPanel != nullptr) {
+        mSSRStatsPanel->setAllParamValues(values);
+    }
+}
+
 
 void SinbadExample::shutdown() {
     Ogre::Viewport &viewport = *getRenderWindow()->getViewport(0);
@@ -23,8 +99,7 @@ void SinbadExample::shutdown() {
     ssr.deinit(
         viewport,
         composer,
-        Ogre::MaterialManager::getSingleton(),
-        Ogre::TextureManager::getSingleton()
+        Ogre::MaterialManager::getSingleton()
     );
 
     mShaderGenerator->removeSceneManager(mSM);
@@ -32,6 +107,7 @@ void SinbadExample::shutdown() {
 
     mRoot->destroySceneManager(mSM);
 
+    mSSRStatsPanel = nullptr;
     delete mTrayMgr;  mTrayMgr = nullptr;
     delete mCamMgr; mCamMgr = nullptr;
 
@@ -43,6 +119,8 @@ void SinbadExample::setup(void) {
 
     // do not forget to call the base first
     OgreBites::ApplicationContext::setup();
+    // compiled programs are kept in the writable path and reused by the next launches
+    enableShaderCache();
     // mRoot->showConfigDialog(nullptr);
 
     // Create the scene manager
@@ -84,10 +162,10 @@ void SinbadExample::setupScene(void) {
     // and tell it to render into the main window
     Viewport* vp = getRenderWindow()->addViewport(cam);
     ssr = ssr_compositor{};
+    ssr.profile = true;
     auto &composer = Ogre::CompositorManager::getSingleton();
     auto &material_manager = Ogre::MaterialManager::getSingleton();
-    auto &texture_manager = Ogre::TextureManager::getSingleton();
-    ssr.init(*vp, composer, material_manager, texture_manager);
+    ssr.init(*vp, composer, material_manager);
     ssr.enable_pipelines(*vp, composer);
 
 
@@ -187,4 +265,17 @@ void SinbadExample::setupScene(void) {
     sphereNode->attachObject(sphere);
     sphereNode->setPosition(-5, -5, 2.5);
     sphereNode->setScale(0.02, 0.02, 0.02);
+
+
+    //------------------------------------------------------------------------
+    // Build the normal_depth_rough techniques of the scene before its first frame
+
+    std::vector<Ogre::MaterialPtr> materials{};
+    for (const auto &[name, object] : mSM->getMovableObjects("Entity")) {
+        (void)name;
+        for (const Ogre::SubEntity *sub_entity : static_cast<Ogre::Entity *>(object)->getSubEntities()) {
+            materials.push_back(sub_entity->getMaterial());
+        }
+    }
+    ssr.prewarm(materials);
 }
\ No newline at end of file
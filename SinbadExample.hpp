@@ -28,6 +28,7 @@ public:
 
 protected:
     virtual bool keyPressed(const OgreBites::KeyboardEvent& evt);
+    virtual void frameRendered(const Ogre::FrameEvent& evt);
     virtual void setup();
     virtual void shutdown();
     virtual void setupScene();
@@ -37,6 +38,7 @@ protected:
 
     Ogre::SceneManager* mSM = nullptr;
     OgreBites::TrayManager* mTrayMgr = nullptr;
+    OgreBites::ParamsPanel* mSSRStatsPanel = nullptr;
 
     Ogre::Light* light = nullptr;
     Ogre::SceneNode* mLightParent = nullptr;
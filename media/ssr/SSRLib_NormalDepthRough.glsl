@@ -0,0 +1,10 @@
+// RTSS library for ssr_ndr_render_state, same layout as ssr_output_normal_depth_rough_fp.glsl unpacked
+
+float SSR_LuminanceFromRGB(vec3 rgb) {
+    return dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void SSR_NormalDepthRough(in vec3 normal_vs, in vec4 position_cs, in vec4 specular, in float shininess, out vec4 normal_depth_rough) {
+    float roughness = pow(1.0 - SSR_LuminanceFromRGB(specular.rgb), shininess);
+    normal_depth_rough = vec4(normalize(normal_vs).xy, position_cs.z / position_cs.w, roughness);
+}
@@ -0,0 +1,17 @@
+// edge stopping weight of the denoise and the upsample, how well a sample's surface matches the centre one
+
+#ifndef SSR_BILATERAL_GLSL
+#define SSR_BILATERAL_GLSL
+
+// relative view depth difference at which a sample loses most of its weight
+const float DEPTH_SIGMA = 0.05;
+const float NORMAL_POWER = 16.0;
+
+
+float bilateral_weight(float depth_linear, vec3 normal_vs, float centre_depth_linear, vec3 centre_normal_vs) {
+    float depth_weight = exp(-abs(depth_linear - centre_depth_linear) / (DEPTH_SIGMA * centre_depth_linear));
+    float normal_weight = pow(max(dot(normal_vs, centre_normal_vs), 0.0), NORMAL_POWER);
+    return depth_weight * normal_weight;
+}
+
+#endif
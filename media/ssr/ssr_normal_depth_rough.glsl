@@ -0,0 +1,116 @@
+// normal, depth and roughness of the visible surfaces, written by ssr_output_normal_depth_rough_fp.glsl
+// unpacked: one PF_FLOAT32_RGBA target with the view space normal xy, ndc01 depth and roughness
+// SSR_NDR_PACKED: octahedral normal in PF_SHORT_GR, ndc01 depth in PF_FLOAT32_R and roughness in PF_R8
+
+#ifndef SSR_NORMAL_DEPTH_ROUGH_GLSL
+#define SSR_NORMAL_DEPTH_ROUGH_GLSL
+
+#ifndef SSR_NDR_WRITER
+uniform sampler2D normal_depth_rough_texture;
+#ifdef SSR_NDR_PACKED
+uniform sampler2D ndr_depth_texture;
+uniform sampler2D ndr_roughness_texture;
+#endif
+#endif
+
+
+// source: https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+vec2 octahedral_wrap(vec2 v) {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+vec2 octahedral_unorm_from_normal(vec3 normal) {
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 encoded = normal.z >= 0.0 ? normal.xy : octahedral_wrap(normal.xy);
+    return encoded * 0.5 + 0.5;
+}
+vec3 normal_from_octahedral_unorm(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-normal.z, 0.0, 1.0);
+    normal.xy += vec2(normal.x >= 0.0 ? -fold : fold, normal.y >= 0.0 ? -fold : fold);
+    return normalize(normal);
+}
+
+
+#ifndef SSR_NDR_WRITER
+struct normal_depth_rough_sample {
+    vec3 normal_vs;
+    float depth_ndc01;
+    float roughness;
+};
+
+#ifdef SSR_NDR_CACHE
+// defined by the includer over the neighbourhood it keeps in shared memory, false outside of it
+bool ndr_cache_find(ivec2 texel, out normal_depth_rough_sample result);
+#endif
+normal_depth_rough_sample normal_depth_rough_from_sampler(vec2 uv) {
+    normal_depth_rough_sample result;
+#ifdef SSR_NDR_CACHE
+    // unfiltered, the sampler reads the texel under uv
+    if (ndr_cache_find(ivec2(floor(uv * vec2(textureSize(normal_depth_rough_texture, 0)))), result)) {
+        return result;
+    }
+#endif
+#ifdef SSR_NDR_PACKED
+    result.normal_vs = normal_from_octahedral_unorm(texture(normal_depth_rough_texture, uv).xy);
+    result.depth_ndc01 = texture(ndr_depth_texture, uv).r;
+    result.roughness = texture(ndr_roughness_texture, uv).r;
+#else
+    vec4 nd = texture(normal_depth_rough_texture, uv);
+    result.normal_vs = normalize(vec3(nd.xy, sqrt(1.0 - dot(nd.xy, nd.xy))));
+    result.depth_ndc01 = nd.z;
+    result.roughness = nd.w;
+#endif
+    return result;
+}
+
+normal_depth_rough_sample normal_depth_rough_from_texel(ivec2 texel) {
+    normal_depth_rough_sample result;
+#ifdef SSR_NDR_CACHE
+    if (ndr_cache_find(texel, result)) {
+        return result;
+    }
+#endif
+#ifdef SSR_NDR_PACKED
+    result.normal_vs = normal_from_octahedral_unorm(texelFetch(normal_depth_rough_texture, texel, 0).xy);
+    result.depth_ndc01 = texelFetch(ndr_depth_texture, texel, 0).r;
+    result.roughness = texelFetch(ndr_roughness_texture, texel, 0).r;
+#else
+    vec4 nd = texelFetch(normal_depth_rough_texture, texel, 0);
+    result.normal_vs = normalize(vec3(nd.xy, sqrt(1.0 - dot(nd.xy, nd.xy))));
+    result.depth_ndc01 = nd.z;
+    result.roughness = nd.w;
+#endif
+    return result;
+}
+
+// depth only reads, packed targets then skip the normal and roughness planes entirely
+float depth_ndc01_from_sampler(vec2 uv) {
+#ifdef SSR_NDR_CACHE
+    normal_depth_rough_sample cached;
+    if (ndr_cache_find(ivec2(floor(uv * vec2(textureSize(normal_depth_rough_texture, 0)))), cached)) {
+        return cached.depth_ndc01;
+    }
+#endif
+#ifdef SSR_NDR_PACKED
+    return texture(ndr_depth_texture, uv).r;
+#else
+    return texture(normal_depth_rough_texture, uv).z;
+#endif
+}
+float depth_ndc01_from_texel(ivec2 texel) {
+#ifdef SSR_NDR_CACHE
+    normal_depth_rough_sample cached;
+    if (ndr_cache_find(texel, cached)) {
+        return cached.depth_ndc01;
+    }
+#endif
+#ifdef SSR_NDR_PACKED
+    return texelFetch(ndr_depth_texture, texel, 0).r;
+#else
+    return texelFetch(normal_depth_rough_texture, texel, 0).z;
+#endif
+}
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+#version 410
+
+// one axis of a bilateral blur of the reflection, SSR_DENOISE_VERTICAL picks the second
+// the radius grows with roughness, the colour is averaged by reflection weight so misses don't darken it
+
+uniform sampler2D reflection_texture;
+
+uniform float near_clip_plane;
+uniform float far_clip_plane;
+
+#include "ssr_normal_depth_rough.glsl"
+#include "ssr_render_scale.glsl"
+#include "ssr_bilateral.glsl"
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 0) out vec4 out_fragment_color;
+
+
+const float EPSILON = 0.0001;
+const float FAR_MAX_NDC = 1.0 - EPSILON;
+
+// reflection texels on each side of a fully rough surface
+const int RADIUS_MAX = 6;
+
+#ifdef SSR_DENOISE_VERTICAL
+const ivec2 AXIS = ivec2(0, 1);
+#else
+const ivec2 AXIS = ivec2(1, 0);
+#endif
+
+
+float depth_linear_from_ndc01(float depth_ndc01) {
+    return near_clip_plane * far_clip_plane / (far_clip_plane - depth_ndc01 * (far_clip_plane - near_clip_plane));
+}
+
+void main() {
+    // texels past the render scale were not traced this frame, samples stop at its edge
+    ivec2 reflection_size = render_scale_texels(textureSize(reflection_texture, 0), raytrace_render_scale.xy);
+    vec2 reflection_screen_size = render_scale_screen_size(textureSize(reflection_texture, 0), raytrace_render_scale.xy);
+    ivec2 texel = ivec2(floor(in_uv * vec2(textureSize(reflection_texture, 0))));
+    vec4 centre = texelFetch(reflection_texture, texel, 0);
+
+    normal_depth_rough_sample ndr = normal_depth_rough_from_sampler((vec2(texel) + 0.5) / reflection_screen_size);
+    int radius = int(ceil(ndr.roughness * float(RADIUS_MAX)));
+    if (ndr.depth_ndc01 > FAR_MAX_NDC || radius == 0) {
+        out_fragment_color = centre;
+        return;
+    }
+    float depth_linear = depth_linear_from_ndc01(ndr.depth_ndc01);
+    float sigma = float(radius) * 0.5;
+
+    vec3 colour = centre.rgb * centre.a;
+    float reflection_weight_sum = centre.a;
+    float weight_sum = 1.0;
+    for (int i = -RADIUS_MAX; i <= RADIUS_MAX; ++i) {
+        if (i == 0 || abs(i) > radius) {
+            continue;
+        }
+        ivec2 sample_texel = texel + AXIS * i;
+        if (any(lessThan(sample_texel, ivec2(0))) || any(greaterThanEqual(sample_texel, reflection_size))) {
+            continue;
+        }
+        // the reflection texel was traced from the full resolution surface at its centre
+        normal_depth_rough_sample sample_ndr = normal_depth_rough_from_sampler((vec2(sample_texel) + 0.5) / reflection_screen_size);
+        float spatial_weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        float weight = spatial_weight * bilateral_weight(
+            depth_linear_from_ndc01(sample_ndr.depth_ndc01), sample_ndr.normal_vs, depth_linear, ndr.normal_vs
+        );
+
+        vec4 reflection = texelFetch(reflection_texture, sample_texel, 0);
+        colour += reflection.rgb * reflection.a * weight;
+        reflection_weight_sum += reflection.a * weight;
+        weight_sum += weight;
+    }
+    out_fragment_color = vec4(colour / max(reflection_weight_sum, EPSILON), reflection_weight_sum / weight_sum);
+}
@@ -0,0 +1,13 @@
+#version 410
+
+uniform vec4 background_colour;
+
+layout(location = 0) out vec4 out_scene_color;
+layout(location = 1) out vec4 out_normal_depth_rough;
+
+
+void main() {
+    out_scene_color = background_colour;
+    // far depth and full roughness, as the separate normal_depth_rough clear
+    out_normal_depth_rough = vec4(0.0, 0.0, 1.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 410
+
+// builds one level of the min depth pyramid from the level above it
+// HIZ_SOURCE_NDR reads depth from the normal_depth_rough target instead of a previous level
+
+uniform sampler2D source_texture;
+uniform vec4 target_size;
+
+layout(location = 0) out vec4 out_fragment_color;
+
+
+float depth_ndc01_from_source(ivec2 texel) {
+#ifdef HIZ_SOURCE_NDR
+    return texelFetch(source_texture, texel, 0).z;
+#else
+    return texelFetch(source_texture, texel, 0).r;
+#endif
+}
+
+void main() {
+    ivec2 source_size = textureSize(source_texture, 0);
+    vec2 source_per_target = vec2(source_size) * target_size.zw;
+
+    // odd sized sources make the footprint up to 3 texels wide
+    ivec2 texel_begin = ivec2(floor(gl_FragCoord.xy - 0.5) * source_per_target);
+    ivec2 texel_end = min(ivec2(ceil((floor(gl_FragCoord.xy - 0.5) + 1.0) * source_per_target)), source_size);
+
+    float min_depth_ndc01 = 1.0;
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+            ivec2 texel = texel_begin + ivec2(x, y);
+            if (all(lessThan(texel, texel_end))) {
+                min_depth_ndc01 = min(min_depth_ndc01, depth_ndc01_from_source(texel));
+            }
+        }
+    }
+    out_fragment_color = vec4(min_depth_ndc01);
+}
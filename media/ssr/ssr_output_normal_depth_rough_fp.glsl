@@ -3,10 +3,19 @@
 uniform vec3 specular;
 uniform float shininess;
 
+#define SSR_NDR_WRITER
+#include "ssr_normal_depth_rough.glsl"
+
 layout(location = 0) in vec3 in_normal_vs;
 layout(location = 1) in vec4 in_position_cs;
 
+#ifdef SSR_NDR_PACKED
+layout(location = 0) out vec4 out_normal;
+layout(location = 1) out vec4 out_depth;
+layout(location = 2) out vec4 out_roughness;
+#else
 out vec4 out_fragment_color;
+#endif
 
 
 float luminance_from_rgb(vec3 rgb) {
@@ -16,5 +25,11 @@ float luminance_from_rgb(vec3 rgb) {
 void main() {
     float roughness = pow(1.0 - luminance_from_rgb(specular), shininess);
     float depth_ndc01 = in_position_cs.z / in_position_cs.w;
+#ifdef SSR_NDR_PACKED
+    out_normal = vec4(octahedral_unorm_from_normal(normalize(in_normal_vs)), 0.0, 0.0);
+    out_depth = vec4(depth_ndc01);
+    out_roughness = vec4(roughness);
+#else
     out_fragment_color = vec4(normalize(in_normal_vs).xy, depth_ndc01, roughness);
+#endif
 }
\ No newline at end of file
@@ -10,25 +10,90 @@
 // Ogre::VES_TANGENT	            tangent             14	    n/a
 // Ogre::VES_BINORMAL	            binormal            15	    n/a
 
+// SSR_NDR_SKINNING: skinned from the 3x4 bone palette with SSR_NDR_BLEND_WEIGHTS weights per vertex
+// SSR_NDR_INSTANCING: the 3x4 instance world matrix in the texture coordinates from SSR_NDR_INSTANCING_UV on
+
+#if defined(SSR_NDR_SKINNING) || defined(SSR_NDR_INSTANCING)
+uniform mat4 view_matrix;
+#else
 uniform mat4 world_view_matrix;
 uniform mat4 it_world_view_matrix;
+#endif
 uniform mat4 projection_matrix;
 
 layout(location = 0) in vec3 in_position_os;
 layout(location = 2) in vec3 in_normal_os;
 
+#ifdef SSR_NDR_SKINNING
+#ifndef SSR_NDR_BONES_MAX
+#define SSR_NDR_BONES_MAX 80
+#endif
+#ifndef SSR_NDR_BLEND_WEIGHTS
+#define SSR_NDR_BLEND_WEIGHTS 4
+#endif
+uniform vec4 world_matrix_array_3x4[SSR_NDR_BONES_MAX * 3];
+layout(location = 1) in vec4 in_blend_weights;
+layout(location = 7) in vec4 in_blend_indices;
+#endif
+
+#ifdef SSR_NDR_INSTANCING
+#ifndef SSR_NDR_INSTANCING_UV
+#define SSR_NDR_INSTANCING_UV 1
+#endif
+layout(location = 8 + SSR_NDR_INSTANCING_UV) in vec4 in_world_matrix_0;
+layout(location = 9 + SSR_NDR_INSTANCING_UV) in vec4 in_world_matrix_1;
+layout(location = 10 + SSR_NDR_INSTANCING_UV) in vec4 in_world_matrix_2;
+#endif
+
 layout(location = 0) out vec3 out_normal_vs;
 layout(location = 1) out vec4 out_position_cs;
 layout(location = 2) out float out_depth_ndc01;
 
+#if defined(SSR_NDR_SKINNING) || defined(SSR_NDR_INSTANCING)
+// inverse transpose of the linear part of a 3x4 matrix, applied on the right like it
+// a degenerate matrix leaves the normals unscaled
+mat3 normal_matrix_from_3x4(mat3x4 matrix) {
+    mat3 linear = mat3(matrix);
+    mat3 cofactor = mat3(cross(linear[1], linear[2]), cross(linear[2], linear[0]), cross(linear[0], linear[1]));
+    float determinant = dot(linear[0], cofactor[0]);
+    return cofactor / (abs(determinant) > 1e-20 ? determinant : 1.0);
+}
+#endif
+
 
 void main() {
     vec3 position_os = in_position_os;
 
+#if defined(SSR_NDR_SKINNING)
+    // unused weights are 0, the components past the vertex element default to 0 and 1 and are left out
+    vec3 position_ws = vec3(0.0);
+    vec3 normal_ws = vec3(0.0);
+    for (int i = 0; i < SSR_NDR_BLEND_WEIGHTS; ++i) {
+        int bone = int(in_blend_indices[i]) * 3;
+        mat3x4 bone_matrix = mat3x4(
+            world_matrix_array_3x4[bone],
+            world_matrix_array_3x4[bone + 1],
+            world_matrix_array_3x4[bone + 2]
+        );
+        position_ws += (vec4(position_os, 1.0) * bone_matrix) * in_blend_weights[i];
+        normal_ws += (in_normal_os * normal_matrix_from_3x4(bone_matrix)) * in_blend_weights[i];
+    }
+#elif defined(SSR_NDR_INSTANCING)
+    mat3x4 world_matrix = mat3x4(in_world_matrix_0, in_world_matrix_1, in_world_matrix_2);
+    vec3 position_ws = vec4(position_os, 1.0) * world_matrix;
+    vec3 normal_ws = in_normal_os * normal_matrix_from_3x4(world_matrix);
+#endif
+
+#if defined(SSR_NDR_SKINNING) || defined(SSR_NDR_INSTANCING)
+    vec4 pos_vs = view_matrix * vec4(position_ws, 1.0);
+    vec3 normal_vs = mat3(view_matrix) * normal_ws;
+#else
     vec4 pos_vs = world_view_matrix * vec4(position_os.xyz, 1.0);
+    vec3 normal_vs = (it_world_view_matrix * vec4(in_normal_os, 0.0)).xyz;
+#endif
     vec4 pos_cs = projection_matrix * vec4(pos_vs.xyz, 1.0);
     
     gl_Position = pos_cs;
     out_position_cs = pos_cs;
-    out_normal_vs = normalize((it_world_view_matrix * vec4(in_normal_os, 0.0)).xyz);
-}
\ No newline at end of file
+    out_normal_vs = normalize(normal_vs);
+}
@@ -0,0 +1,147 @@
+#version 430
+
+// the raytrace of ssr_raytrace.glsl as a compute program
+// each workgroup walks SSR_COMPUTE_TILE_SIZE tiles of output_image until none are left
+// the normal_depth_rough around a tile is cached in shared memory for the short rays
+// with SSR_TILE_CLASSIFY_ENABLE the traced and untraced tiles are compacted into batches first
+
+#define SSR_NDR_CACHE
+#ifndef SSR_COMPUTE_TILE_SIZE
+#define SSR_COMPUTE_TILE_SIZE 8
+#endif
+
+layout(local_size_x = SSR_COMPUTE_TILE_SIZE, local_size_y = SSR_COMPUTE_TILE_SIZE) in;
+
+#include "ssr_raytrace.glsl"
+#include "ssr_render_scale.glsl"
+
+// the ray hit buffer of SSR_OUTPUT_RAY_HIT is PF_FLOAT32_RGBA, the reflection PF_FLOAT16_RGBA
+#ifdef SSR_OUTPUT_RAY_HIT
+layout(rgba32f) uniform writeonly image2D output_image;
+#else
+layout(rgba16f) uniform writeonly image2D output_image;
+#endif
+
+
+// normal_depth_rough texels per side of the cache, centred on the tile
+const int NDR_CACHE_SIZE = 32;
+const int THREADS = SSR_COMPUTE_TILE_SIZE * SSR_COMPUTE_TILE_SIZE;
+
+shared vec4 ndr_cache_normal_depth[NDR_CACHE_SIZE * NDR_CACHE_SIZE];
+shared float ndr_cache_roughness[NDR_CACHE_SIZE * NDR_CACHE_SIZE];
+// the same in every invocation of a group, shared memory is only needed for the texels
+ivec2 ndr_cache_origin;
+bool ndr_cache_valid = false;
+
+#if SSR_TILE_CLASSIFY_ENABLE
+// tile indices of the batch being walked
+shared uint batch_traced[THREADS];
+shared uint batch_skipped[THREADS];
+shared uint batch_traced_count;
+shared uint batch_skipped_count;
+#endif
+
+
+bool ndr_cache_find(ivec2 texel, out normal_depth_rough_sample result) {
+    ivec2 cache_texel = texel - ndr_cache_origin;
+    if (!ndr_cache_valid || any(lessThan(cache_texel, ivec2(0))) || any(greaterThanEqual(cache_texel, ivec2(NDR_CACHE_SIZE)))) {
+        return false;
+    }
+    int index = cache_texel.y * NDR_CACHE_SIZE + cache_texel.x;
+    result.normal_vs = ndr_cache_normal_depth[index].xyz;
+    result.depth_ndc01 = ndr_cache_normal_depth[index].w;
+    result.roughness = ndr_cache_roughness[index];
+    return true;
+}
+
+void ndr_cache_load(ivec2 tile_centre_texel) {
+    ivec2 ndr_size = textureSize(normal_depth_rough_texture, 0);
+    ndr_cache_valid = false;
+    ndr_cache_origin = tile_centre_texel - NDR_CACHE_SIZE / 2;
+    // the clamped texels hold what the clamped sampler would have returned past the edges
+    for (int index = int(gl_LocalInvocationIndex); index < NDR_CACHE_SIZE * NDR_CACHE_SIZE; index += THREADS) {
+        ivec2 texel = ndr_cache_origin + ivec2(index % NDR_CACHE_SIZE, index / NDR_CACHE_SIZE);
+        normal_depth_rough_sample ndr = normal_depth_rough_from_texel(clamp(texel, ivec2(0), ndr_size - 1));
+        ndr_cache_normal_depth[index] = vec4(ndr.normal_vs, ndr.depth_ndc01);
+        ndr_cache_roughness[index] = ndr.roughness;
+    }
+    ndr_cache_valid = true;
+}
+
+// traces a tile of output_image with the whole group
+void trace_tile(ivec2 tile, ivec2 target_size, vec2 screen_size) {
+    vec2 tile_centre_uv = (vec2(tile) + 0.5) * float(SSR_COMPUTE_TILE_SIZE) / screen_size;
+
+    // the previous tile may still be reading the cache
+    barrier();
+    ndr_cache_load(ivec2(tile_centre_uv * vec2(textureSize(normal_depth_rough_texture, 0))));
+    barrier();
+
+    ivec2 pixel = tile * SSR_COMPUTE_TILE_SIZE + ivec2(gl_LocalInvocationID.xy);
+    if (all(lessThan(pixel, target_size))) {
+        imageStore(output_image, pixel, raytrace((vec2(pixel) + 0.5) / screen_size));
+    }
+}
+
+#if SSR_TILE_CLASSIFY_ENABLE
+// whether the classification traces any pixel of a tile of output_image
+bool tile_traced(ivec2 tile, vec2 screen_size) {
+    ivec2 first = tile_class_texel((vec2(tile * SSR_COMPUTE_TILE_SIZE) + 0.5) / screen_size);
+    ivec2 last = tile_class_texel((vec2(tile * SSR_COMPUTE_TILE_SIZE + SSR_COMPUTE_TILE_SIZE - 1) + 0.5) / screen_size);
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            if (texelFetch(tiles_texture, ivec2(x, y), 0).r >= 0.25) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+#endif
+
+void main() {
+    // only the render scale fraction of the image is traced, its texels span the whole screen
+    ivec2 target_size = render_scale_texels(imageSize(output_image), raytrace_render_scale.xy);
+    vec2 screen_size = render_scale_screen_size(imageSize(output_image), raytrace_render_scale.xy);
+    ivec2 tiles = (target_size + SSR_COMPUTE_TILE_SIZE - 1) / SSR_COMPUTE_TILE_SIZE;
+    uint tiles_count = uint(tiles.x * tiles.y);
+#if SSR_TILE_CLASSIFY_ENABLE
+    // every invocation classifies one tile of the batch
+    uint batches_count = (tiles_count + uint(THREADS) - 1u) / uint(THREADS);
+    for (uint batch = gl_WorkGroupID.x; batch < batches_count; batch += gl_NumWorkGroups.x) {
+        // the previous batch may still be reading the lists
+        barrier();
+        if (gl_LocalInvocationIndex == 0u) {
+            batch_traced_count = 0u;
+            batch_skipped_count = 0u;
+        }
+        barrier();
+        uint tile_index = batch * uint(THREADS) + gl_LocalInvocationIndex;
+        if (tile_index < tiles_count) {
+            ivec2 tile = ivec2(int(tile_index) % tiles.x, int(tile_index) / tiles.x);
+            if (tile_traced(tile, screen_size)) {
+                batch_traced[atomicAdd(batch_traced_count, 1u)] = tile_index;
+            } else {
+                batch_skipped[atomicAdd(batch_skipped_count, 1u)] = tile_index;
+            }
+        }
+        barrier();
+
+        // what the raytrace returns for an untraced pixel
+        for (uint i = 0u; i < batch_skipped_count; ++i) {
+            ivec2 tile = ivec2(int(batch_skipped[i]) % tiles.x, int(batch_skipped[i]) / tiles.x);
+            ivec2 pixel = tile * SSR_COMPUTE_TILE_SIZE + ivec2(gl_LocalInvocationID.xy);
+            if (all(lessThan(pixel, target_size))) {
+                imageStore(output_image, pixel, vec4(0.0));
+            }
+        }
+        for (uint i = 0u; i < batch_traced_count; ++i) {
+            trace_tile(ivec2(int(batch_traced[i]) % tiles.x, int(batch_traced[i]) / tiles.x), target_size, screen_size);
+        }
+    }
+#else
+    for (uint tile_index = gl_WorkGroupID.x; tile_index < tiles_count; tile_index += gl_NumWorkGroups.x) {
+        trace_tile(ivec2(int(tile_index) % tiles.x, int(tile_index) / tiles.x), target_size, screen_size);
+    }
+#endif
+}
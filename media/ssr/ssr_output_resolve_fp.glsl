@@ -0,0 +1,99 @@
+#version 410
+
+// source: Stachowiak, "Stochastic Screen-Space Reflections", SIGGRAPH 2015
+// shades every pixel from the hits of the rays traced around it at a lower resolution, each hit
+// weighted by the ggx lobe of this pixel towards it over the pdf of the ray that found it
+// ray_hit_texture holds the hit uv, hit ndc01 depth and pdf of one ray per texel, a 0 pdf for none
+
+uniform sampler2D scene_colour_texture;
+uniform sampler2D ray_hit_texture;
+uniform mat4 raytrace_i_projection_matrix;
+
+#include "ssr_normal_depth_rough.glsl"
+#include "ssr_render_scale.glsl"
+#include "ssr_reflection_weight.glsl"
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 0) out vec4 out_fragment_color;
+
+
+const float EPSILON = 0.0001;
+const float FAR_MAX_NDC = 1.0 - EPSILON;
+const float PI = 3.14159265;
+
+// ray texels on each side of the one under this pixel
+const int RESOLVE_RADIUS = 1;
+
+
+vec3 position_vs_from_uv(vec3 uv) {
+    vec4 position_vs = raytrace_i_projection_matrix * vec4(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, uv.z * 2.0 - 1.0, 1.0);
+    return position_vs.xyz / position_vs.w;
+}
+
+float luminance_from_rgb(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+float ggx_distribution(float n_dot_h, float alpha) {
+    float alpha2 = alpha * alpha;
+    float d = n_dot_h * n_dot_h * (alpha2 - 1.0) + 1.0;
+    return alpha2 / (PI * d * d);
+}
+
+void main() {
+    // the reflection and ray hits share the render scale
+    vec2 uv = min(in_uv / raytrace_render_scale.xy, vec2(1.0));
+    vec4 scene_color = texture(scene_colour_texture, uv);
+    normal_depth_rough_sample ndr = normal_depth_rough_from_sampler(uv);
+    if (ndr.depth_ndc01 > FAR_MAX_NDC) {
+        out_fragment_color = vec4(0.0);
+        return;
+    }
+    vec3 position_vs = position_vs_from_uv(vec3(uv, ndr.depth_ndc01));
+    vec3 view_direction_vs = normalize(position_vs);
+    vec3 reflection_direction_vs = normalize(reflect(view_direction_vs, ndr.normal_vs));
+    float alpha = max(ndr.roughness * ndr.roughness, GGX_ALPHA_MIN);
+
+    ivec2 ray_hit_size = render_scale_texels(textureSize(ray_hit_texture, 0), raytrace_render_scale.xy);
+    vec2 ray_hit_screen_size = render_scale_screen_size(textureSize(ray_hit_texture, 0), raytrace_render_scale.xy);
+    ivec2 ray_texel = min(ivec2(uv * ray_hit_screen_size), ray_hit_size - 1);
+
+    vec3 hit_color = vec3(0.0);
+    float weight_sum = 0.0;
+    for (int y = -RESOLVE_RADIUS; y <= RESOLVE_RADIUS; ++y) {
+        for (int x = -RESOLVE_RADIUS; x <= RESOLVE_RADIUS; ++x) {
+            ivec2 texel = clamp(ray_texel + ivec2(x, y), ivec2(0), ray_hit_size - 1);
+            vec4 ray_hit = texelFetch(ray_hit_texture, texel, 0);
+            if (ray_hit.w <= 0.0) {
+                continue;
+            }
+            vec3 light_direction_vs = normalize(position_vs_from_uv(ray_hit.xyz) - position_vs);
+            float n_dot_l = dot(ndr.normal_vs, light_direction_vs);
+            if (n_dot_l <= 0.0) {
+                continue;
+            }
+            vec3 half_vs = normalize(light_direction_vs - view_direction_vs);
+            float n_dot_h = max(dot(ndr.normal_vs, half_vs), 0.0);
+            // the epsilon keeps near mirrors from losing every neighbour to their narrow lobe
+            float weight = ggx_distribution(n_dot_h, alpha) * n_dot_l / ray_hit.w + EPSILON;
+            hit_color += texture(scene_colour_texture, ray_hit.xy).rgb * weight;
+            weight_sum += weight;
+        }
+    }
+    if (weight_sum == 0.0) {
+        out_fragment_color = vec4(0.0);
+        return;
+    }
+    hit_color /= weight_sum;
+
+    // the reflection factor of ssr_raytrace.glsl, from the resolved hit colour
+    float roughness_factor = pow(1.0 - ndr.roughness, ROUGHNESS_POWER);
+    float fresnel_factor = pow(1.0 - max(dot(-view_direction_vs, ndr.normal_vs), 0.0), FRESNEL_POWER);
+    float luminance_factor = pow(luminance_from_rgb(hit_color) / (luminance_from_rgb(scene_color.rgb) + 1.0), LUMINANCE_POWER);
+    float front_ray_factor = pow(1.0 - max(reflection_direction_vs.z, 0.0), FRONT_RAY_DISCARD_POWER);
+    float reflection_factor = front_ray_factor * pow(
+        fresnel_factor * (luminance_factor + roughness_factor) * roughness_factor,
+        1.0 / REFLECTION_POWER_BIAS
+    );
+    out_fragment_color = vec4(hit_color, reflection_factor);
+}
@@ -0,0 +1,23 @@
+#version 410
+
+// builds one level of the blurred scene colour pyramid from the level above it
+// four bilinear taps around the centre cover a 4x4 footprint, weighted with the centre
+// 2x2 into a tent so levels stay smooth enough to be blended across when cone tracing
+
+uniform sampler2D source_texture;
+uniform vec4 target_size;
+
+layout(location = 0) out vec4 out_fragment_color;
+
+
+void main() {
+    vec2 uv = gl_FragCoord.xy * target_size.zw;
+    vec2 source_texel = 1.0 / vec2(textureSize(source_texture, 0));
+
+    vec4 centre = texture(source_texture, uv);
+    vec4 corners = texture(source_texture, uv + vec2(-1.0, -1.0) * source_texel)
+                 + texture(source_texture, uv + vec2( 1.0, -1.0) * source_texel)
+                 + texture(source_texture, uv + vec2(-1.0,  1.0) * source_texel)
+                 + texture(source_texture, uv + vec2( 1.0,  1.0) * source_texel);
+    out_fragment_color = centre * 0.5 + corners * 0.125;
+}
@@ -0,0 +1,71 @@
+#version 410
+
+uniform sampler2D reflection_texture;
+uniform sampler2D history_texture;
+uniform mat4 raytrace_i_projection_matrix;
+uniform mat4 raytrace_i_view_matrix;
+uniform mat4 raytrace_previous_view_projection_matrix;
+
+#include "ssr_normal_depth_rough.glsl"
+#include "ssr_render_scale.glsl"
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 0) out vec4 out_fragment_color;
+
+
+// weight of the reprojected history against the reflection traced this frame
+const float HISTORY_BLEND = 0.9;
+
+
+vec3 position_uv_from_ndc(vec3 position_ndc) {
+    return vec3(position_ndc.x * 0.5 + 0.5, 0.5 - position_ndc.y * 0.5, position_ndc.z * 0.5 + 0.5);
+}
+vec3 position_ndc_from_uv(vec3 uv) {
+    return vec3(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, uv.z * 2.0 - 1.0);
+}
+vec3 position_vs_from_ndc(vec3 position_ndc) {
+    vec4 pos_vs = raytrace_i_projection_matrix * vec4(position_ndc, 1.0);
+    return pos_vs.xyz / pos_vs.w;
+}
+vec3 position_ws_from_vs(vec3 position_vs) {
+    vec4 pos_ws = raytrace_i_view_matrix * vec4(position_vs, 1.0);
+    return pos_ws.xyz;
+}
+
+
+void main() {
+    // the reflection is at the render scale of this frame, the history at its own
+    vec2 uv = min(in_uv / raytrace_render_scale.xy, vec2(1.0));
+    vec4 current = texture(reflection_texture, in_uv);
+
+    // reproject the reflecting surface, the reflection itself moves with it closely enough
+    float depth_ndc01 = depth_ndc01_from_sampler(uv);
+    vec3 position_vs = position_vs_from_ndc(position_ndc_from_uv(vec3(uv, depth_ndc01)));
+    vec4 previous_position_cs = raytrace_previous_view_projection_matrix * vec4(position_ws_from_vs(position_vs), 1.0);
+    vec2 previous_uv = position_uv_from_ndc(previous_position_cs.xyz / previous_position_cs.w).xy;
+
+    bool disoccluded = previous_position_cs.w <= 0.0
+        || any(lessThan(previous_uv, vec2(0.0)))
+        || any(greaterThan(previous_uv, vec2(1.0)));
+    if (disoccluded) {
+        out_fragment_color = current;
+        return;
+    }
+
+    // clamp the history to the colour range of the current neighbourhood to reject stale samples
+    ivec2 size = render_scale_texels(textureSize(reflection_texture, 0), raytrace_render_scale.xy);
+    ivec2 texel = ivec2(in_uv * vec2(textureSize(reflection_texture, 0)));
+    vec4 neighbourhood_min = current;
+    vec4 neighbourhood_max = current;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec4 neighbour = texelFetch(reflection_texture, clamp(texel + ivec2(x, y), ivec2(0), size - 1), 0);
+            neighbourhood_min = min(neighbourhood_min, neighbour);
+            neighbourhood_max = max(neighbourhood_max, neighbour);
+        }
+    }
+    vec2 history_uv = render_scale_uv(previous_uv, textureSize(history_texture, 0), raytrace_render_scale.zw);
+    vec4 history = clamp(texture(history_texture, history_uv), neighbourhood_min, neighbourhood_max);
+
+    out_fragment_color = mix(current, history, HISTORY_BLEND);
+}
@@ -0,0 +1,66 @@
+#version 410
+
+// classifies SSR_TILE_SIZE tiles by the largest reflection weight the raytrace can give in them
+// luminance_factor is at most 1 with an 8 bit scene colour, which bounds the weight without tracing
+// 0 leaves the tile untraced, 0.5 traces it coarsely and 1 fully
+
+uniform mat4 raytrace_i_projection_matrix;
+uniform vec4 target_size;
+
+#include "ssr_normal_depth_rough.glsl"
+#include "ssr_reflection_weight.glsl"
+
+layout(location = 0) out vec4 out_fragment_color;
+
+
+#ifndef SSR_TILE_SIZE
+#define SSR_TILE_SIZE 8
+#endif
+
+const float FAR_MAX_NDC = 1.0 - 0.0001;
+
+// below one 8 bit step a reflection changes nothing, below WEIGHT_FULL_MIN its errors are hardly visible
+const float WEIGHT_TRACE_MIN = 1.0 / 255.0;
+const float WEIGHT_FULL_MIN = 0.125;
+
+
+float weight_max_from_texel(ivec2 texel, vec2 ndr_size) {
+    normal_depth_rough_sample ndr = normal_depth_rough_from_texel(texel);
+    if (ndr.depth_ndc01 > FAR_MAX_NDC) {
+        return 0.0;
+    }
+    vec2 uv = (vec2(texel) + 0.5) / ndr_size;
+    vec4 position_vs = raytrace_i_projection_matrix * vec4(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, ndr.depth_ndc01 * 2.0 - 1.0, 1.0);
+    vec3 view_direction_vs = normalize(position_vs.xyz / position_vs.w);
+    vec3 reflection_direction_vs = normalize(reflect(view_direction_vs, ndr.normal_vs));
+
+    float roughness_factor = pow(1.0 - ndr.roughness, ROUGHNESS_POWER);
+    float fresnel_factor = pow(1.0 - max(dot(-view_direction_vs, ndr.normal_vs), 0.0), FRESNEL_POWER);
+    float front_ray_factor = pow(1.0 - max(reflection_direction_vs.z, 0.0), FRONT_RAY_DISCARD_POWER);
+    return front_ray_factor * sqrt(fresnel_factor * (1.0 + roughness_factor) * roughness_factor);
+}
+
+void main() {
+    ivec2 ndr_size = textureSize(normal_depth_rough_texture, 0);
+    ivec2 tiles_size = ivec2(target_size.xy);
+    ivec2 tile = ivec2(floor(gl_FragCoord.xy - 0.5));
+
+    // the last row and column of tiles also cover what is left past a whole number of tiles
+    ivec2 texel_begin = tile * SSR_TILE_SIZE;
+    ivec2 texel_end = min(texel_begin + SSR_TILE_SIZE, ndr_size);
+    if (tile.x == tiles_size.x - 1) {
+        texel_end.x = ndr_size.x;
+    }
+    if (tile.y == tiles_size.y - 1) {
+        texel_end.y = ndr_size.y;
+    }
+
+    float weight_max = 0.0;
+    for (int y = texel_begin.y; y < texel_end.y && weight_max < WEIGHT_FULL_MIN; ++y) {
+        for (int x = texel_begin.x; x < texel_end.x; ++x) {
+            weight_max = max(weight_max, weight_max_from_texel(ivec2(x, y), vec2(ndr_size)));
+        }
+    }
+    float tile_class = weight_max < WEIGHT_TRACE_MIN ? 0.0 : (weight_max < WEIGHT_FULL_MIN ? 0.5 : 1.0);
+    out_fragment_color = vec4(tile_class);
+}
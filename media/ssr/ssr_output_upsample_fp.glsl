@@ -0,0 +1,68 @@
+#version 410
+
+uniform sampler2D scene_colour_texture;
+uniform sampler2D reflection_texture;
+
+uniform float near_clip_plane;
+uniform float far_clip_plane;
+
+#include "ssr_normal_depth_rough.glsl"
+#include "ssr_render_scale.glsl"
+#include "ssr_bilateral.glsl"
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 0) out vec4 out_fragment_color;
+
+
+const float EPSILON = 0.0001;
+const float FAR_MAX_NDC = 1.0 - EPSILON;
+
+
+float depth_linear_from_ndc01(float depth_ndc01) {
+    return near_clip_plane * far_clip_plane / (far_clip_plane - depth_ndc01 * (far_clip_plane - near_clip_plane));
+}
+
+
+// bilateral upsample: bilinear weights of the 4 nearest low resolution texels, scaled by how
+// well the full resolution surface under each of them matches the one of this pixel
+void main() {
+    vec4 scene_color = texture(scene_colour_texture, in_uv);
+    normal_depth_rough_sample ndr = normal_depth_rough_from_sampler(in_uv);
+    if (ndr.depth_ndc01 > FAR_MAX_NDC) {
+        out_fragment_color = scene_color;
+        return;
+    }
+    float depth_linear = depth_linear_from_ndc01(ndr.depth_ndc01);
+
+    // only the render scale fraction of the reflection was written this frame, it spans the screen
+    ivec2 reflection_size = render_scale_texels(textureSize(reflection_texture, 0), raytrace_render_scale.xy);
+    vec2 reflection_screen_size = render_scale_screen_size(textureSize(reflection_texture, 0), raytrace_render_scale.xy);
+    vec2 position_texel = in_uv * reflection_screen_size - 0.5;
+    vec2 base_texel = floor(position_texel);
+    vec2 bilinear = position_texel - base_texel;
+
+    vec4 reflection = vec4(0.0);
+    float weight_sum = 0.0;
+    for (int y = 0; y < 2; ++y) {
+        for (int x = 0; x < 2; ++x) {
+            vec2 offset = vec2(x, y);
+            ivec2 texel = clamp(ivec2(base_texel + offset), ivec2(0), reflection_size - 1);
+            vec2 texel_uv = (vec2(texel) + 0.5) / reflection_screen_size;
+
+            // the low resolution trace point sampled the full resolution target at its texel centre
+            normal_depth_rough_sample coarse = normal_depth_rough_from_sampler(texel_uv);
+            vec2 bilinear_xy = mix(1.0 - bilinear, bilinear, offset);
+            float bilinear_weight = bilinear_xy.x * bilinear_xy.y;
+            float surface_weight = bilateral_weight(
+                depth_linear_from_ndc01(coarse.depth_ndc01), coarse.normal_vs, depth_linear, ndr.normal_vs
+            );
+
+            float weight = bilinear_weight * (surface_weight + EPSILON);
+            reflection += texelFetch(reflection_texture, texel, 0) * weight;
+            weight_sum += weight;
+        }
+    }
+    reflection /= max(weight_sum, EPSILON);
+
+    out_fragment_color = mix(scene_color, vec4(reflection.rgb, scene_color.a), reflection.a);
+}
@@ -0,0 +1,733 @@
+// the raytrace of ssr_output_raytrace_fp.glsl and ssr_output_raytrace_cp.glsl, included after their #version
+
+#ifndef SSR_RAYTRACE_GLSL
+#define SSR_RAYTRACE_GLSL
+
+uniform sampler2D scene_colour_texture;
+uniform sampler2D hiz_1_texture;
+uniform sampler2D hiz_2_texture;
+uniform sampler2D hiz_3_texture;
+uniform sampler2D hiz_4_texture;
+uniform sampler2D hiz_5_texture;
+uniform sampler2D hiz_6_texture;
+uniform mat4 raytrace_i_projection_matrix;
+uniform mat4 raytrace_projection_matrix;
+uniform mat4 raytrace_i_view_matrix;
+uniform int raytrace_frame;
+
+
+uniform float near_clip_plane;
+uniform float far_clip_plane;
+
+#include "ssr_normal_depth_rough.glsl"
+#include "ssr_reflection_weight.glsl"
+
+
+const uint UINT_MAX = 0xffffffffu;
+const float INFINITY = 1.0 / 0.0;
+const float EPSILON = 0.0001;
+const float FAR_MAX_NDC = 1.0 - EPSILON;
+
+// quality knobs, ssr_compositor presets override them through preprocessor defines
+#ifndef SSR_STEPS_MAX
+#define SSR_STEPS_MAX 64
+#endif
+#ifndef SSR_STEPS_BSEARCH_MAX
+#define SSR_STEPS_BSEARCH_MAX 8
+#endif
+#ifndef SSR_STEPS_HIZ_MAX
+#define SSR_STEPS_HIZ_MAX 48
+#endif
+#ifndef SSR_DISTANCE_MAX_VS
+#define SSR_DISTANCE_MAX_VS 16.0
+#endif
+#ifndef SSR_THICKNESS_RADIUS_VS
+#define SSR_THICKNESS_RADIUS_VS 0.5
+#endif
+#ifndef SSR_FRUSTUM_CLIP_ENABLE
+#define SSR_FRUSTUM_CLIP_ENABLE 1
+#endif
+#ifndef SSR_BSEARCH_ENABLE
+#define SSR_BSEARCH_ENABLE 1
+#endif
+#ifndef SSR_HIZ_TRAVERSAL_ENABLE
+#define SSR_HIZ_TRAVERSAL_ENABLE 1
+#endif
+// without the hi-z traversal, march normal_depth_rough texel by texel instead of in clip space steps
+#ifndef SSR_DDA_ENABLE
+#define SSR_DDA_ENABLE 1
+#endif
+// SSR_TILE_SIZE square tiles of tiles_texture tell which pixels are traced, see ssr_output_tiles_fp.glsl
+#ifndef SSR_TILE_CLASSIFY_ENABLE
+#define SSR_TILE_CLASSIFY_ENABLE 0
+#endif
+#ifndef SSR_TILE_SIZE
+#define SSR_TILE_SIZE 8
+#endif
+
+// SSR_GLOSSY_ENABLE cone traces rough reflections through the blurred scene colour pyramid
+// of ssr_output_scene_blur_fp.glsl instead of jittering the rays
+#ifndef SSR_GLOSSY_ENABLE
+#define SSR_GLOSSY_ENABLE 0
+#endif
+// SSR_TEMPORAL_ENABLE redraws the ray jitter every frame for the temporal pass to accumulate
+#ifndef SSR_TEMPORAL_ENABLE
+#define SSR_TEMPORAL_ENABLE 0
+#endif
+
+#if SSR_TILE_CLASSIFY_ENABLE
+uniform sampler2D tiles_texture;
+
+// texel of tiles_texture classifying the surface at uv
+ivec2 tile_class_texel(vec2 uv) {
+    return min(
+        ivec2(floor(uv * vec2(textureSize(normal_depth_rough_texture, 0)))) / SSR_TILE_SIZE,
+        textureSize(tiles_texture, 0) - 1
+    );
+}
+#endif
+#if SSR_GLOSSY_ENABLE
+uniform sampler2D scene_blur_1_texture;
+uniform sampler2D scene_blur_2_texture;
+uniform sampler2D scene_blur_3_texture;
+uniform sampler2D scene_blur_4_texture;
+uniform sampler2D scene_blur_5_texture;
+#endif
+
+const float DISTANCE_MAX_VS = float(SSR_DISTANCE_MAX_VS);
+const float THICKNESS_RADIUS_VS = float(SSR_THICKNESS_RADIUS_VS);
+const float JITTER_SCALE = 0.1;
+
+const uint STEPS_MAX = uint(SSR_STEPS_MAX);
+const uint STEPS_BSEARCH_MAX = uint(SSR_STEPS_BSEARCH_MAX);
+const uint STEPS_HIZ_MAX = uint(SSR_STEPS_HIZ_MAX);
+// cheap trace tiles only hold faint reflections, a coarse march is enough for them
+const uint STEPS_CHEAP_MAX = max(STEPS_MAX / 4u, 1u);
+const uint STEPS_HIZ_CHEAP_MAX = max(STEPS_HIZ_MAX / 2u, 1u);
+
+// synchronized with ssr_compositor::hiz_levels
+const int HIZ_LEVELS = 6;
+// synchronized with ssr_compositor::scene_blur_levels
+const int SCENE_BLUR_LEVELS = 5;
+// cone half angle tangent of a fully rough surface
+const float CONE_TAN_MAX = 0.5;
+
+
+vec4 position_cs_from_vs(vec3 position_vs) {
+    return raytrace_projection_matrix * vec4(position_vs, 1.0);
+}
+vec3 position_ndc_from_cs(vec4 position_cs) {
+    return position_cs.xyz / position_cs.w;
+}
+vec3 position_uv_from_ndc(vec3 position_ndc) {
+    return vec3(position_ndc.x * 0.5 + 0.5, 0.5 - position_ndc.y * 0.5, position_ndc.z * 0.5 + 0.5);
+}
+
+vec3 position_ndc_from_uv(vec3 uv) {
+    return vec3(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, uv.z * 2.0 - 1.0);
+}
+vec3 position_vs_from_ndc(vec3 position_ndc) {
+    vec4 pos_vs = raytrace_i_projection_matrix * vec4(position_ndc, 1.0);
+    return pos_vs.xyz / pos_vs.w;
+}
+vec3 position_ws_from_vs(vec3 position_vs) {
+    vec4 pos_ws = raytrace_i_view_matrix * vec4(position_vs, 1.0);
+    return pos_ws.xyz;
+}
+
+// source: https://stackoverflow.com/a/46118945
+// BUG: precission issues compared to full inv matrix multiplication
+float depth_vs_from_ndc01(float depth_ndc01) {
+    float A     = raytrace_projection_matrix[2][2];
+    float B     = raytrace_projection_matrix[3][2];
+    float z_ndc = 2.0 * depth_ndc01 - 1.0;
+    float z_vs = B / (A + z_ndc);
+    return -z_vs;
+}
+
+// positive view distance from the clip planes, steadier than going through the projection matrix
+float depth_linear_from_ndc01(float depth_ndc01) {
+    return near_clip_plane * far_clip_plane / (far_clip_plane - depth_ndc01 * (far_clip_plane - near_clip_plane));
+}
+
+
+// source: https://zznewclear13.github.io/posts/screen-space-reflection-en/#frustum-clipping
+vec3 segment_end_clip_vs_from(vec3 origin_vs, vec3 end_vs, vec2 near_far_clip_distances, vec2 near_plane_half_size) {
+    origin_vs.z *= -1.0;
+    end_vs.z *= -1.0;
+
+    vec3 dir = end_vs - origin_vs;
+    vec3 signDir = sign(dir);
+
+    float nfSlab = signDir.z * (near_far_clip_distances.y - near_far_clip_distances.x) * 0.5f + (near_far_clip_distances.y + near_far_clip_distances.x) * 0.5f;
+    float lenZ = (nfSlab - origin_vs.z) / dir.z;
+    if (dir.z == 0.0f) lenZ = INFINITY;
+
+    vec2 ss = sign(dir.xy - near_plane_half_size * dir.z) * near_plane_half_size;
+    vec2 denom = ss * dir.z - dir.xy;
+    vec2 lenXY = (origin_vs.xy - ss * origin_vs.z) / denom;
+    if (lenXY.x < 0.0f || denom.x == 0.0f) lenXY.x = INFINITY;
+    if (lenXY.y < 0.0f || denom.y == 0.0f) lenXY.y = INFINITY;
+
+    float len = min(min(1.0f, lenZ), min(lenXY.x, lenXY.y));
+    vec3 clippedVS = origin_vs + dir * len;
+
+    clippedVS.z *= -1.0;
+    return clippedVS;
+}
+vec3 segment_end_clip_vs(vec3 origin_vs, vec3 end_vs) {
+    return segment_end_clip_vs_from(
+        origin_vs,
+        end_vs,
+        vec2(near_clip_plane, far_clip_plane),
+        vec2(1.0, 1.0) / vec2(raytrace_projection_matrix[0][0], raytrace_projection_matrix[1][1])
+    );
+}
+
+
+vec4 intersection_binary_search_uv(vec4 origin_cs, vec4 end_cs, vec4 origin_front_cs, vec4 end_front_cs, float w, float prev_w) {
+    vec2 hit_sample_uv = vec2(0.0);
+    float hit_sample_depth_ndc01 = 0.0;
+    float hit = 0.0;
+    for (uint i = 0; i < STEPS_BSEARCH_MAX; ++i) {
+        float mid_w = (w + prev_w) * 0.5;
+
+        vec4 position_cs = mix(origin_cs, end_cs, mid_w);
+        vec4 position_front_cs = mix(origin_front_cs, end_front_cs, mid_w);
+
+        float ray_depth_ndc = position_cs.z / position_cs.w;
+        float ray_front_depth_ndc = position_front_cs.z / position_front_cs.w;
+
+        vec2 sample_uv = position_uv_from_ndc(vec3(position_cs.xy / position_cs.w, ray_depth_ndc)).xy;
+        normal_depth_rough_sample nd = normal_depth_rough_from_sampler(sample_uv);
+        float sample_depth_ndc01 = nd.depth_ndc01;
+        float sample_depth_ndc = sample_depth_ndc01 * 2.0 - 1.0;
+
+        if (ray_depth_ndc >= sample_depth_ndc) {
+            w = mid_w;
+            if (ray_front_depth_ndc <= sample_depth_ndc) {
+                hit_sample_uv = sample_uv;
+                hit_sample_depth_ndc01 = sample_depth_ndc01;
+                hit = 1.0;
+            } else {
+                w = (w + prev_w) * 0.5;
+            }
+        } else {
+            prev_w = mid_w;
+        }
+    }
+    return vec4(hit_sample_uv, hit_sample_depth_ndc01, hit);
+}
+
+vec4 intersection_binary_minimization_uv(
+    vec4 origin_cs, vec4 end_cs, vec4 origin_front_cs, vec4 end_front_cs, float min_depth_difference_ndc, float w, float prev_w
+) {
+    vec2 hit_sample_uv = vec2(0.0);
+    float hit_sample_depth_ndc01 = 0.0;
+    float hit = 0.0;
+
+    for (uint i = 0; i < STEPS_BSEARCH_MAX; ++i) {
+        float mid_w = (w + prev_w) * 0.5;
+
+        vec4 position_cs = mix(origin_cs, end_cs, mid_w);
+        vec4 position_front_cs = mix(origin_front_cs, end_front_cs, mid_w);
+
+        float ray_depth_ndc = position_cs.z / position_cs.w;
+        float ray_front_depth_ndc = position_front_cs.z / position_front_cs.w;
+
+        vec2 sample_uv = position_uv_from_ndc(vec3(position_cs.xy / position_cs.w, ray_depth_ndc)).xy;
+        normal_depth_rough_sample nd = normal_depth_rough_from_sampler(sample_uv);
+        float sample_depth_ndc01 = nd.depth_ndc01;
+        float sample_depth_ndc = sample_depth_ndc01 * 2.0 - 1.0;
+        float depth_difference_ndc = ray_depth_ndc - sample_depth_ndc;
+
+        if (depth_difference_ndc >= 0.0) {
+            w = mid_w;
+            if (ray_front_depth_ndc <= sample_depth_ndc) {
+                if (depth_difference_ndc < min_depth_difference_ndc) {
+                    hit_sample_depth_ndc01 = sample_depth_ndc01;
+                    hit_sample_uv = sample_uv;
+                    hit = 1.0;
+                    min_depth_difference_ndc = depth_difference_ndc;
+                } 
+            } else {
+                w = (w + prev_w) * 0.5;
+            }
+        } else {
+            prev_w = mid_w;
+        }
+    }
+    return vec4(hit_sample_uv, hit_sample_depth_ndc01, hit);
+}
+
+vec4 intersection_raymarch_uv(vec3 origin_vs, vec3 direction_vs, float max_distance_vs, uint steps_max) {
+    vec3 end_vs = origin_vs + direction_vs * max_distance_vs;
+#if SSR_FRUSTUM_CLIP_ENABLE
+    end_vs = segment_end_clip_vs(origin_vs, end_vs);
+#endif
+    vec4 origin_cs = position_cs_from_vs(origin_vs);
+    vec4 end_cs = position_cs_from_vs(end_vs);
+    vec4 origin_front_cs = position_cs_from_vs(origin_vs + vec3(0.0, 0.0, THICKNESS_RADIUS_VS));
+    vec4 end_front_cs = position_cs_from_vs(end_vs + vec3(0.0, 0.0, THICKNESS_RADIUS_VS));
+
+    float w = 0.0;
+    float dw = 1.0 / float(steps_max);
+    float potential_w = 0.0;
+    float min_depth_difference_ndc = INFINITY;
+
+    vec2 sample_uv;
+    float sample_depth_ndc01;
+    for (uint i = 0; i < steps_max; ++i) {
+        w += dw;
+
+        vec4 position_cs = mix(origin_cs, end_cs, w);
+        vec4 position_front_cs = mix(origin_front_cs, end_front_cs, w);
+
+        float ray_depth_ndc = position_cs.z / position_cs.w;
+        float ray_front_depth_ndc = position_front_cs.z / position_front_cs.w;
+
+        sample_uv = position_uv_from_ndc(vec3(position_cs.xy / position_cs.w, ray_depth_ndc)).xy;
+        normal_depth_rough_sample nd = normal_depth_rough_from_sampler(sample_uv);
+        sample_depth_ndc01 = nd.depth_ndc01;
+        float sample_depth_ndc = sample_depth_ndc01 * 2.0 - 1.0;
+        float depth_difference_ndc = ray_depth_ndc - sample_depth_ndc;
+
+        if (depth_difference_ndc >= 0.0 && dot(direction_vs, nd.normal_vs) < 0.0) {
+            if (ray_front_depth_ndc <= sample_depth_ndc) {
+                vec4 hit_uv = vec4(sample_uv, sample_depth_ndc01, 1.0);
+#if SSR_BSEARCH_ENABLE
+                vec4 bsearch_hit_uv = intersection_binary_search_uv(
+                    origin_cs, end_cs, origin_front_cs, end_front_cs, w, w - dw
+                );
+                return mix(hit_uv, bsearch_hit_uv, bsearch_hit_uv.w);
+#else
+                return hit_uv;
+#endif
+            } else if (depth_difference_ndc < min_depth_difference_ndc) {
+                min_depth_difference_ndc = depth_difference_ndc;
+                potential_w = w;
+            }
+        }
+    }
+
+    vec4 hit_uv = vec4(sample_uv, sample_depth_ndc01, 0.0);
+#if SSR_BSEARCH_ENABLE
+    if (potential_w > 0.0) {
+        vec4 bsearch_hit_uv = intersection_binary_minimization_uv(
+            origin_cs, end_cs, origin_front_cs, end_front_cs, min_depth_difference_ndc, potential_w, potential_w - dw
+        );
+        return mix(hit_uv, bsearch_hit_uv, bsearch_hit_uv.w);
+    }
+#endif
+    return hit_uv;
+}
+
+
+// source: McGuire and Mara, "Efficient GPU Screen-Space Ray Tracing", JCGT 2014
+// walks the ray one normal_depth_rough texel per step along its major axis
+// rays longer than steps_max texels stride and refine the last stride with a binary search
+vec4 intersection_dda_uv(vec3 origin_vs, vec3 direction_vs, float max_distance_vs, uint steps_max) {
+    vec3 end_vs = origin_vs + direction_vs * max_distance_vs;
+#if SSR_FRUSTUM_CLIP_ENABLE
+    end_vs = segment_end_clip_vs(origin_vs, end_vs);
+#endif
+    ivec2 ndr_size = textureSize(normal_depth_rough_texture, 0);
+    vec4 origin_cs = position_cs_from_vs(origin_vs);
+    vec4 end_cs = position_cs_from_vs(end_vs);
+    float k0 = 1.0 / origin_cs.w;
+    float k1 = 1.0 / end_cs.w;
+    float q0 = origin_vs.z * k0;
+    float q1 = end_vs.z * k1;
+    vec2 p0 = position_uv_from_ndc(vec3(origin_cs.xy * k0, 0.0)).xy * vec2(ndr_size);
+    vec2 p1 = position_uv_from_ndc(vec3(end_cs.xy * k1, 0.0)).xy * vec2(ndr_size);
+
+    // a ray along the view direction still moves by a texel
+    vec2 delta = p1 - p0;
+    if (dot(delta, delta) < 0.0001) {
+        p1 += vec2(0.01);
+        delta = p1 - p0;
+    }
+    bool permute = abs(delta.x) < abs(delta.y);
+    if (permute) {
+        delta = delta.yx;
+        p0 = p0.yx;
+        p1 = p1.yx;
+    }
+    float step_sign = sign(delta.x);
+    float stride = max(1.0, abs(delta.x) / float(steps_max));
+    float step_x = step_sign * stride / delta.x;
+    vec2 dp = vec2(step_sign, delta.y / abs(delta.x)) * stride;
+    float dq = (q1 - q0) * step_x;
+    float dk = (k1 - k0) * step_x;
+
+    // the origin texel is skipped, it would hit itself
+    vec2 p = p0 + dp;
+    float q = q0 + dq;
+    float k = k0 + dk;
+    float ray_z_previous = origin_vs.z;
+    ivec2 texel = ivec2(floor(permute ? p0.yx : p0));
+    normal_depth_rough_sample nd = normal_depth_rough_from_texel(clamp(texel, ivec2(0), ndr_size - 1));
+    for (uint i = 0; i < steps_max && (p.x - p1.x) * step_sign <= 0.0; ++i) {
+        texel = ivec2(floor(permute ? p.yx : p));
+        if (any(lessThan(texel, ivec2(0))) || any(greaterThanEqual(texel, ndr_size))) {
+            break;
+        }
+        // view depths the ray spans within this step, the next one starts half a step further
+        float ray_z = (q + dq * 0.5) / (k + dk * 0.5);
+        float ray_z_near = max(ray_z_previous, ray_z);
+        float ray_z_far = min(ray_z_previous, ray_z);
+        ray_z_previous = ray_z;
+
+        nd = normal_depth_rough_from_texel(texel);
+        float sample_z = -depth_linear_from_ndc01(nd.depth_ndc01);
+        if (ray_z_far <= sample_z && ray_z_near + THICKNESS_RADIUS_VS >= sample_z && dot(direction_vs, nd.normal_vs) < 0.0) {
+#if SSR_BSEARCH_ENABLE
+            // the first point of the stride behind the surface, the thickness test already held for its span
+            float w_front = 0.0;
+            float w_behind = 1.0;
+            for (uint j = 0; stride > 1.0 && j < STEPS_BSEARCH_MAX; ++j) {
+                float w = (w_front + w_behind) * 0.5;
+                vec2 p_mid = p - dp * (1.0 - w);
+                ivec2 texel_mid = clamp(ivec2(floor(permute ? p_mid.yx : p_mid)), ivec2(0), ndr_size - 1);
+                float ray_z_mid = (q - dq * (1.0 - w)) / (k - dk * (1.0 - w));
+                normal_depth_rough_sample nd_mid = normal_depth_rough_from_texel(texel_mid);
+                if (ray_z_mid <= -depth_linear_from_ndc01(nd_mid.depth_ndc01)) {
+                    w_behind = w;
+                    texel = texel_mid;
+                    nd = nd_mid;
+                } else {
+                    w_front = w;
+                }
+            }
+#endif
+            return vec4((vec2(texel) + 0.5) / vec2(ndr_size), nd.depth_ndc01, 1.0);
+        }
+        p += dp;
+        q += dq;
+        k += dk;
+    }
+    texel = clamp(texel, ivec2(0), ndr_size - 1);
+    return vec4((vec2(texel) + 0.5) / vec2(ndr_size), nd.depth_ndc01, 0.0);
+}
+
+
+// level 0 is the full resolution normal_depth_rough target, the rest hold the min depth of their footprint
+ivec2 hiz_size(int level) {
+    switch (level) {
+        case 1: return textureSize(hiz_1_texture, 0);
+        case 2: return textureSize(hiz_2_texture, 0);
+        case 3: return textureSize(hiz_3_texture, 0);
+        case 4: return textureSize(hiz_4_texture, 0);
+        case 5: return textureSize(hiz_5_texture, 0);
+        case 6: return textureSize(hiz_6_texture, 0);
+        default: return textureSize(normal_depth_rough_texture, 0);
+    }
+}
+float hiz_depth_ndc01(int level, ivec2 texel) {
+    switch (level) {
+        case 1: return texelFetch(hiz_1_texture, texel, 0).r;
+        case 2: return texelFetch(hiz_2_texture, texel, 0).r;
+        case 3: return texelFetch(hiz_3_texture, texel, 0).r;
+        case 4: return texelFetch(hiz_4_texture, texel, 0).r;
+        case 5: return texelFetch(hiz_5_texture, texel, 0).r;
+        case 6: return texelFetch(hiz_6_texture, texel, 0).r;
+        default: return depth_ndc01_from_texel(texel);
+    }
+}
+
+// ray parameter at which the ray leaves the cell containing position_uv at the given level
+float hiz_cell_exit_w(vec3 origin_uv, vec2 inverse_delta_uv, vec2 cross_offset_uv, vec2 position_uv, int level) {
+    vec2 size = vec2(hiz_size(level));
+    vec2 cell = floor(position_uv * size);
+    vec2 boundary_uv = (cell + step(vec2(0.0), cross_offset_uv)) / size + cross_offset_uv;
+    vec2 boundary_w = (boundary_uv - origin_uv.xy) * inverse_delta_uv;
+    return min(boundary_w.x, boundary_w.y);
+}
+
+// source: Uludag, "Hi-Z Screen-Space Cone-Traced Reflections", GPU Pro 5
+// walks the ray in uv and ndc01 depth, where it is linear, going coarse while the ray
+// stays in front of the min depth of a cell and fine when it may be behind it
+vec4 intersection_hiz_uv(vec3 origin_vs, vec3 direction_vs, float max_distance_vs, uint steps_max) {
+    vec3 end_vs = origin_vs + direction_vs * max_distance_vs;
+#if SSR_FRUSTUM_CLIP_ENABLE
+    end_vs = segment_end_clip_vs(origin_vs, end_vs);
+#endif
+    vec3 origin_uv = position_uv_from_ndc(position_ndc_from_cs(position_cs_from_vs(origin_vs)));
+    vec3 end_uv = position_uv_from_ndc(position_ndc_from_cs(position_cs_from_vs(end_vs)));
+    vec3 delta_uv = end_uv - origin_uv;
+
+    vec2 safe_delta_uv = mix(delta_uv.xy, vec2(EPSILON * EPSILON), equal(delta_uv.xy, vec2(0.0)));
+    vec2 inverse_delta_uv = 1.0 / safe_delta_uv;
+    vec2 cross_offset_uv = sign(safe_delta_uv) * 0.05 / vec2(hiz_size(0));
+
+    // skip the texel the ray starts on
+    float w = hiz_cell_exit_w(origin_uv, inverse_delta_uv, cross_offset_uv, origin_uv.xy, 0);
+    int level = 0;
+    for (uint i = 0; i < steps_max && level >= 0 && w < 1.0; ++i) {
+        vec3 position_uv = origin_uv + delta_uv * w;
+        ivec2 cell = ivec2(floor(position_uv.xy * vec2(hiz_size(level))));
+        float cell_depth_ndc01 = hiz_depth_ndc01(level, cell);
+        float exit_w = hiz_cell_exit_w(origin_uv, inverse_delta_uv, cross_offset_uv, position_uv.xy, level);
+
+        if (position_uv.z < cell_depth_ndc01) {
+            float depth_w = delta_uv.z > 0.0 ? (cell_depth_ndc01 - origin_uv.z) / delta_uv.z : INFINITY;
+            if (depth_w < exit_w) {
+                w = depth_w;
+                --level;
+            } else {
+                w = exit_w;
+                level = min(level + 1, HIZ_LEVELS);
+            }
+        } else {
+            --level;
+        }
+    }
+
+    vec3 sample_uv = origin_uv + delta_uv * clamp(w, 0.0, 1.0);
+    normal_depth_rough_sample nd = normal_depth_rough_from_sampler(sample_uv.xy);
+    float thickness_vs = depth_vs_from_ndc01(nd.depth_ndc01) - depth_vs_from_ndc01(sample_uv.z);
+    bool hit = level < 0
+        && w < 1.0
+        && thickness_vs <= THICKNESS_RADIUS_VS
+        && dot(direction_vs, nd.normal_vs) < 0.0;
+    return vec4(sample_uv.xy, nd.depth_ndc01, hit ? 1.0 : 0.0);
+}
+
+
+vec4 test_coordinates(vec3 uv) {
+    const float BORDER_SIZE = 0.01;
+    vec2 quadrant_uv = (uv.xy - vec2(0.5)) * 2.0;
+    vec2 border_xy = step(abs(quadrant_uv), vec2(BORDER_SIZE));
+    float border = max(border_xy.x, border_xy.y) * 0.5;
+
+    vec3 position_ndc = position_ndc_from_uv(uv);
+    vec3 position_vs = position_vs_from_ndc(position_ndc);
+
+    vec4 position_cs_reprojected = position_cs_from_vs(position_vs);
+    vec3 position_ndc_reprojected = position_ndc_from_cs(position_cs_reprojected);
+    vec3 uv_reprojected = position_uv_from_ndc(position_ndc_reprojected);
+    float depth_reprojected_vs = depth_vs_from_ndc01(uv_reprojected.z);
+    vec3 position_vs_reprojected = position_vs_from_ndc(position_ndc_reprojected);
+
+    float uv_eq = step(dot(uv - uv_reprojected, uv - uv_reprojected), EPSILON);
+    float ndc_eq = step(dot(position_ndc - position_ndc_reprojected, position_ndc - position_ndc_reprojected), EPSILON);
+    float depth_eq = step(abs(depth_reprojected_vs - position_vs.z), EPSILON);
+    float vs_eq = step(dot(position_vs - position_vs_reprojected, position_vs - position_vs_reprojected), EPSILON);
+
+    float top_left =        step(quadrant_uv.x, -BORDER_SIZE)   * step(quadrant_uv.y, -BORDER_SIZE);
+    float top_right =       step(BORDER_SIZE, quadrant_uv.x)    * step(quadrant_uv.y, -BORDER_SIZE);
+    float bottom_left =     step(quadrant_uv.x, -BORDER_SIZE)   * step(BORDER_SIZE, quadrant_uv.y);
+    float bottom_right =    step(BORDER_SIZE, quadrant_uv.x)    * step(BORDER_SIZE, quadrant_uv.y);
+
+    float tests = 0.0; 
+    tests += uv_eq * top_left;
+    tests += ndc_eq * top_right;
+    tests += depth_eq * bottom_left;
+    tests += vs_eq * bottom_right;
+    return vec4(border + tests);
+}
+
+
+float luminance_from_rgb(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// source: https://www.shadertoy.com/view/XlGcRh
+uvec2 pcg2d(uvec2 v) {
+    v = v * 1664525u + 1013904223u;
+
+    v.x += v.y * 1664525u;
+    v.y += v.x * 1664525u;
+
+    v = v ^ (v>>16u);
+
+    v.x += v.y * 1664525u;
+    v.y += v.x * 1664525u;
+
+    v = v ^ (v>>16u);
+
+    return v;
+}
+// http://www.jcgt.org/published/0009/03/02/
+uvec3 pcg3d(uvec3 v) {
+
+    v = v * 1664525u + 1013904223u;
+
+    v.x += v.y*v.z;
+    v.y += v.z*v.x;
+    v.z += v.x*v.y;
+
+    v ^= v >> 16u;
+
+    v.x += v.y*v.z;
+    v.y += v.z*v.x;
+    v.z += v.x*v.y;
+
+    return v;
+}
+// source: https://www.shadertoy.com/view/4djSRW
+vec3 hash33(vec3 p3){
+    p3 = fract(p3 * vec3(.1031, .1030, .0973));
+    p3 += dot(p3, p3.yxz+33.33);
+    return fract((p3.xxy + p3.yxx)*p3.zyx);
+}
+// uniform random numbers in [0, 1] for a surface point, drawn again every frame only when
+// the samples are accumulated or reused, a single frame would flicker
+vec3 random_from_position_ws(vec3 position_ws) {
+    uvec3 seed = uvec3(hash33(position_ws) * float(UINT_MAX));
+#if SSR_TEMPORAL_ENABLE || defined(SSR_OUTPUT_RAY_HIT)
+    seed.z ^= uint(raytrace_frame);
+#endif
+    return vec3(pcg3d(seed)) / float(UINT_MAX);
+}
+
+#if SSR_GLOSSY_ENABLE
+vec4 scene_colour_level(int level, vec2 uv) {
+    switch (level) {
+    case 0: return texture(scene_colour_texture, uv);
+    case 1: return texture(scene_blur_1_texture, uv);
+    case 2: return texture(scene_blur_2_texture, uv);
+    case 3: return texture(scene_blur_3_texture, uv);
+    case 4: return texture(scene_blur_4_texture, uv);
+    default: return texture(scene_blur_5_texture, uv);
+    }
+}
+
+// source: Uludag, "Hi-Z Screen-Space Cone-Traced Reflections", GPU Pro 5
+// the width of the cone where it reaches the hit, in scene colour texels, picks the pyramid level
+vec4 scene_colour_cone(vec2 origin_uv, vec2 hit_uv, float roughness) {
+    float hit_distance = length((hit_uv - origin_uv) * vec2(textureSize(scene_colour_texture, 0)));
+    float footprint = 2.0 * hit_distance * CONE_TAN_MAX * roughness * roughness;
+    float level = clamp(log2(max(footprint, 1.0)), 0.0, float(SCENE_BLUR_LEVELS));
+    int level_fine = int(floor(level));
+    return mix(
+        scene_colour_level(level_fine, hit_uv),
+        scene_colour_level(min(level_fine + 1, SCENE_BLUR_LEVELS), hit_uv),
+        fract(level)
+    );
+}
+#endif
+
+#ifdef SSR_OUTPUT_RAY_HIT
+const float PI = 3.14159265;
+
+float ggx_alpha_from_roughness(float roughness) {
+    return max(roughness * roughness, GGX_ALPHA_MIN);
+}
+float ggx_distribution(float n_dot_h, float alpha) {
+    float alpha2 = alpha * alpha;
+    float d = n_dot_h * n_dot_h * (alpha2 - 1.0) + 1.0;
+    return alpha2 / (PI * d * d);
+}
+// source: Walter et al., "Microfacet Models for Refraction through Rough Surfaces"
+vec3 ggx_half_vector_vs(vec3 normal_vs, vec2 random, float alpha) {
+    float phi = 2.0 * PI * random.x;
+    float cos_theta = sqrt((1.0 - random.y) / (1.0 + (alpha * alpha - 1.0) * random.y));
+    float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+    vec3 tangent_vs = normalize(cross(abs(normal_vs.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0), normal_vs));
+    vec3 bitangent_vs = cross(normal_vs, tangent_vs);
+    return normalize(tangent_vs * (sin_theta * cos(phi)) + bitangent_vs * (sin_theta * sin(phi)) + normal_vs * cos_theta);
+}
+#endif
+
+// SSR_OUTPUT_REFLECTION blends in a later pass, SSR_OUTPUT_RAY_HIT shades in ssr_output_resolve_fp.glsl
+vec4 output_color_from(vec4 scene_color, vec4 hit_color, float reflection_factor) {
+#if defined(SSR_OUTPUT_RAY_HIT)
+    return vec4(0.0);
+#elif defined(SSR_OUTPUT_REFLECTION)
+    return vec4(hit_color.rgb, reflection_factor);
+#else
+    return mix(scene_color, hit_color, reflection_factor);
+#endif
+}
+
+// the reflection, or the scene colour it composites into, of the surface at in_uv
+vec4 raytrace(vec2 in_uv) {
+    vec4 scene_color = texture(scene_colour_texture, in_uv);
+    vec3 normal_vs;
+    float depth_ndc01;
+    normal_depth_rough_sample ndr = normal_depth_rough_from_sampler(in_uv);
+    normal_vs = ndr.normal_vs;
+    depth_ndc01 = ndr.depth_ndc01;
+    if (depth_ndc01 > FAR_MAX_NDC) {
+        return output_color_from(scene_color, vec4(0.0), 0.0);
+    }
+
+    uint steps_max = STEPS_MAX;
+    uint steps_hiz_max = STEPS_HIZ_MAX;
+#if SSR_TILE_CLASSIFY_ENABLE
+    float tile_class = texelFetch(tiles_texture, tile_class_texel(in_uv), 0).r;
+    if (tile_class < 0.25) {
+        return output_color_from(scene_color, vec4(0.0), 0.0);
+    }
+    if (tile_class < 0.75) {
+        steps_max = STEPS_CHEAP_MAX;
+        steps_hiz_max = STEPS_HIZ_CHEAP_MAX;
+    }
+#endif
+
+    vec3 position_ndc = position_ndc_from_uv(vec3(in_uv, depth_ndc01));
+    vec3 position_vs = position_vs_from_ndc(position_ndc);
+    vec3 view_direction_vs = normalize(position_vs);
+    vec3 reflection_direction_vs = normalize(reflect(view_direction_vs, normal_vs));
+
+    float roughness_factor = pow(1.0 - ndr.roughness, ROUGHNESS_POWER);
+
+#if defined(SSR_OUTPUT_RAY_HIT)
+    // one importance sampled ray, the resolve weighs its hit for every pixel around by their own lobes
+    vec3 position_ws = position_ws_from_vs(position_vs);
+    vec3 random = random_from_position_ws(position_ws);
+    float alpha = ggx_alpha_from_roughness(ndr.roughness);
+    vec3 half_vs = ggx_half_vector_vs(normal_vs, random.xy, alpha);
+    vec3 ray_direction_vs = reflect(view_direction_vs, half_vs);
+    if (dot(ray_direction_vs, normal_vs) <= 0.0) {
+        half_vs = normal_vs;
+        ray_direction_vs = reflection_direction_vs;
+    }
+    float n_dot_h = max(dot(normal_vs, half_vs), EPSILON);
+    float ray_pdf = ggx_distribution(n_dot_h, alpha) * n_dot_h / (4.0 * max(dot(-view_direction_vs, half_vs), EPSILON));
+#elif SSR_GLOSSY_ENABLE
+    vec3 ray_direction_vs = reflection_direction_vs;
+#else
+    vec3 position_ws = position_ws_from_vs(position_vs);
+    vec3 jitter = random_from_position_ws(position_ws) * 2.0 - 1.0;
+    vec3 ray_direction_vs = reflection_direction_vs + normal_vs * jitter * (1.0 - roughness_factor) * JITTER_SCALE;
+#endif
+
+#if SSR_HIZ_TRAVERSAL_ENABLE
+    vec4 hit_uv = intersection_hiz_uv(position_vs, ray_direction_vs, DISTANCE_MAX_VS, steps_hiz_max);
+#elif SSR_DDA_ENABLE
+    vec4 hit_uv = intersection_dda_uv(position_vs, ray_direction_vs, DISTANCE_MAX_VS, steps_max);
+#else
+    vec4 hit_uv = intersection_raymarch_uv(position_vs, ray_direction_vs, DISTANCE_MAX_VS, steps_max);
+#endif
+#ifdef SSR_OUTPUT_RAY_HIT
+    // rays leaving through the far plane still reflect the sky
+    bool ray_hit = hit_uv.w != 0.0 || hit_uv.z > FAR_MAX_NDC;
+    return ray_hit ? vec4(hit_uv.xyz, ray_pdf) : vec4(0.0);
+#endif
+#if SSR_GLOSSY_ENABLE
+    vec4 hit_color = scene_colour_cone(in_uv, hit_uv.xy, ndr.roughness);
+#else
+    vec4 hit_color = texture(scene_colour_texture, hit_uv.xy);
+#endif
+
+    float fresnel_factor = pow(1.0 - max(dot(-view_direction_vs, normal_vs), 0.0), FRESNEL_POWER);
+
+    float hit_luminance = luminance_from_rgb(hit_color.rgb);
+    float scene_luminance = luminance_from_rgb(scene_color.rgb);
+    float luminance_factor = pow(hit_luminance / (scene_luminance + 1.0), LUMINANCE_POWER);
+
+    float front_ray_factor = pow(1.0 - max(dot(reflection_direction_vs, vec3(0.0, 0.0, 1.0)), 0.0), FRONT_RAY_DISCARD_POWER);
+    float reflection_factor = front_ray_factor * pow(
+        fresnel_factor * (luminance_factor + roughness_factor) * roughness_factor,
+        1.0 / REFLECTION_POWER_BIAS
+    );
+
+    if (hit_uv.w == 0.0) {
+        return output_color_from(scene_color, hit_color, hit_uv.z > FAR_MAX_NDC ? reflection_factor : 0.0);
+    }
+    return output_color_from(scene_color, hit_color, reflection_factor);
+}
+
+#endif
@@ -0,0 +1,14 @@
+// how much of a traced reflection is blended in, shared by the raytrace, the resolve and the tile classification
+
+#ifndef SSR_REFLECTION_WEIGHT_GLSL
+#define SSR_REFLECTION_WEIGHT_GLSL
+
+const float ROUGHNESS_POWER             =  1.2;
+const float FRESNEL_POWER               =  1.2;
+const float LUMINANCE_POWER             =  2.2;
+const float FRONT_RAY_DISCARD_POWER     =  0.8;
+const float REFLECTION_POWER_BIAS       =  2.0;
+
+const float GGX_ALPHA_MIN = 0.02;
+
+#endif
@@ -0,0 +1,29 @@
+// dynamic resolution: the reflection targets are written in their top left raytrace_render_scale fraction
+// xy holds the scale of this frame, zw the one of the history
+// without SSR_DYNAMIC_RESOLUTION the whole target is written
+
+#ifndef SSR_RENDER_SCALE_GLSL
+#define SSR_RENDER_SCALE_GLSL
+
+#ifdef SSR_DYNAMIC_RESOLUTION
+uniform vec4 raytrace_render_scale;
+#else
+const vec4 raytrace_render_scale = vec4(1.0);
+#endif
+
+
+// texels of a reflection target covering the screen at scale, may be fractional
+vec2 render_scale_screen_size(ivec2 texture_size, vec2 scale) {
+    return vec2(texture_size) * scale;
+}
+// texels written at scale, from the top left
+ivec2 render_scale_texels(ivec2 texture_size, vec2 scale) {
+    return min(ivec2(ceil(render_scale_screen_size(texture_size, scale))), texture_size);
+}
+// screen uv of a filtered read, kept half a texel inside the part written at scale
+vec2 render_scale_uv(vec2 screen_uv, ivec2 texture_size, vec2 scale) {
+    vec2 half_texel = 0.5 / vec2(texture_size);
+    return clamp(screen_uv * scale, half_texel, scale - half_texel);
+}
+
+#endif
@@ -0,0 +1,390 @@
+#include "ssr_compositor.hpp"
+
+#include <OgreApplicationContext.h>
+#include <OgreRoot.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <OgreRTShaderSystem.h>
+#include <OgreEntity.h>
+#include <OgreSubEntity.h>
+#include <OgreTechnique.h>
+#include <OgreMeshManager.h>
+#include <OgreTextureManager.h>
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreRenderTexture.h>
+#include <OgreCompositorManager.h>
+#include <OgreViewport.h>
+#include <OgreCamera.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// renders ssr_compositor offscreen along a scripted camera path and prints the frame times as json
+//
+// ssr_benchmark [--frames N] [--warmup N] [--resolution WxH]...
+//               [--pipeline full|temporal|half|quarter|stochastic|stochastic_quarter]...
+//               [--preset low|medium|high|ultra]... [--render-system NAME] [--media DIR] [--output FILE]
+//
+// the ssr materials are GLSL 4.1, which the Tiny software render system does not run, so machines
+// without a gpu use the OpenGL 3+ render system on Mesa llvmpipe (LIBGL_ALWAYS_SOFTWARE=1)
+
+static constexpr std::array<std::string_view, ssr_compositor::pipelines_count> benchmark_pipeline_names{
+    "full",
+    "temporal",
+    "half",
+    "quarter",
+    "stochastic",
+    "stochastic_quarter",
+};
+static constexpr std::array<std::string_view, ssr_compositor::quality_presets_count> benchmark_preset_names{
+    "low",
+    "medium",
+    "high",
+    "ultra",
+};
+
+struct benchmark_options {
+    size_t frames = 240;
+    size_t warmup = 30;
+    std::vector<std::pair<unsigned, unsigned>> resolutions{};
+    std::vector<size_t> pipelines{};
+    std::vector<size_t> presets{};
+    std::string render_system = "OpenGL 3+ Rendering Subsystem";
+    std::string media{};
+    std::string output{};
+};
+
+struct benchmark_run {
+    unsigned width;
+    unsigned height;
+    size_t pipeline;
+    size_t preset;
+    std::vector<double> frame_ms;
+    std::vector<ssr_profiler::report> stages;
+};
+
+template<size_t N>
+static bool benchmark_parse_name(const std::array<std::string_view, N> &names, std::string_view value, std::vector<size_t> &out) {
+    for (size_t i = 0; i < N; ++i) {
+        if (names[i] == value) {
+            out.push_back(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool benchmark_parse(int argc, char *argv[], benchmark_options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view option = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = argv[++i];
+        if (option == "--frames") {
+            options.frames = std::strtoul(value, nullptr, 10);
+        } else if (option == "--warmup") {
+            options.warmup = std::strtoul(value, nullptr, 10);
+        } else if (option == "--resolution") {
+            unsigned width = 0;
+            unsigned height = 0;
+            if (std::sscanf(value, "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+                return false;
+            }
+            options.resolutions.emplace_back(width, height);
+        } else if (option == "--pipeline") {
+            if (!benchmark_parse_name(benchmark_pipeline_names, value, options.pipelines)) {
+                return false;
+            }
+        } else if (option == "--preset") {
+            if (!benchmark_parse_name(benchmark_preset_names, value, options.presets)) {
+                return false;
+            }
+        } else if (option == "--render-system") {
+            options.render_system = value;
+        } else if (option == "--media") {
+            options.media = value;
+        } else if (option == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+    }
+    if (options.frames == 0) {
+        return false;
+    }
+    if (options.resolutions.empty()) {
+        options.resolutions.emplace_back(1280, 720);
+    }
+    if (options.pipelines.empty()) {
+        for (size_t i = 0; i < ssr_compositor::pipelines_count; ++i) {
+            options.pipelines.push_back(i);
+        }
+    }
+    if (options.presets.empty()) {
+        options.presets.push_back(ssr_compositor::quality_high);
+    }
+    return true;
+}
+
+struct ssr_benchmark : public OgreBites::ApplicationContext {
+    benchmark_options options;
+    Ogre::SceneManager *scene_manager = nullptr;
+    Ogre::Camera *camera = nullptr;
+    Ogre::SceneNode *camera_node = nullptr;
+    std::vector<benchmark_run> runs{};
+
+    explicit ssr_benchmark(benchmark_options options) :
+        OgreBites::ApplicationContext("ssr_benchmark"),
+        options{std::move(options)} { }
+
+    bool oneTimeConfig() override {
+        Ogre::RenderSystem *render_system = mRoot->getRenderSystemByName(options.render_system);
+        if (render_system == nullptr) {
+            return false;
+        }
+        mRoot->setRenderSystem(render_system);
+        return true;
+    }
+    // the window only provides the context, every frame renders into a render texture
+    OgreBites::NativeWindowPair createWindow(
+        const Ogre::String &name,
+        Ogre::uint32 w,
+        Ogre::uint32 h,
+        Ogre::NameValuePairList miscParams
+    ) override {
+        (void)w;
+        (void)h;
+        miscParams["hidden"] = "true";
+        OgreBites::NativeWindowPair window = OgreBites::ApplicationContextBase::createWindow(name, 1, 1, miscParams);
+        window.render->setAutoUpdated(false);
+        return window;
+    }
+    void pollEvents() override { }
+    void locateResources() override {
+        OgreBites::ApplicationContext::locateResources();
+        if (!options.media.empty()) {
+            auto &resource_manager = Ogre::ResourceGroupManager::getSingleton();
+            resource_manager.addResourceLocation(options.media, "FileSystem", Ogre::RGN_DEFAULT);
+            resource_manager.addResourceLocation(options.media + "/ssr", "FileSystem", Ogre::RGN_DEFAULT);
+        }
+    }
+
+    void setup() override {
+        OgreBites::ApplicationContext::setup();
+        scene_manager = mRoot->createSceneManager();
+        mShaderGenerator->addSceneManager(scene_manager);
+        setup_scene();
+    }
+    void shutdown() override {
+        if (scene_manager != nullptr) {
+            mShaderGenerator->removeSceneManager(scene_manager);
+            mRoot->destroySceneManager(scene_manager);
+            scene_manager = nullptr;
+        }
+        OgreBites::ApplicationContext::shutdown();
+    }
+
+    // the SinbadExample scene, without anything animated
+    void setup_scene() {
+        camera = scene_manager->createCamera("BenchmarkCam");
+        camera->setNearClipDistance(1);
+        camera->setFarClipDistance(100);
+        camera->setAutoAspectRatio(true);
+        camera_node = scene_manager->getRootSceneNode()->createChildSceneNode();
+        camera_node->attachObject(camera);
+
+        Ogre::Light *light = scene_manager->createLight();
+        light->setType(Ogre::Light::LT_DIRECTIONAL);
+        light->setDiffuseColour(0.75, 0.75, 0.75);
+        Ogre::SceneNode *light_node = scene_manager->getRootSceneNode()->createChildSceneNode();
+        light_node->attachObject(light);
+        light_node->setDirection(Ogre::Vector3(-1, -1, -1));
+
+        scene_manager->getRootSceneNode()->createChildSceneNode()->attachObject(scene_manager->createEntity("Sinbad.mesh"));
+
+        Ogre::MeshManager::getSingleton().createPlane(
+            "ssr_benchmark_plane",
+            Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+            Ogre::Plane(Ogre::Vector3::UNIT_Y, 0),
+            15, 15, 4, 4, true,
+            1, 4, 4, Ogre::Vector3::UNIT_Z
+        );
+        Ogre::SceneNode *floor_node = scene_manager->getRootSceneNode()->createChildSceneNode();
+        floor_node->attachObject(scene_manager->createEntity("ssr_benchmark_plane"));
+        floor_node->setPosition(0, -5, 0);
+
+        Ogre::Entity *back_plane = scene_manager->createEntity("ssr_benchmark_plane");
+        back_plane->getSubEntity(0)->getTechnique()->getPass(0)->setSpecular(0.75, 0.8, 0.95, 1.0);
+        back_plane->getSubEntity(0)->getTechnique()->getPass(0)->setShininess(32.0f);
+        Ogre::SceneNode *back_plane_node = scene_manager->getRootSceneNode()->createChildSceneNode();
+        back_plane_node->attachObject(back_plane);
+        back_plane_node->setPosition(0, 2.5, -7.5);
+        back_plane_node->pitch(Ogre::Degree(90));
+
+        Ogre::Entity *sphere = scene_manager->createEntity("sphere.mesh");
+        sphere->getSubEntity(0)->setMaterialName("Examples/Chrome");
+        Ogre::SceneNode *sphere_node = scene_manager->getRootSceneNode()->createChildSceneNode();
+        sphere_node->attachObject(sphere);
+        sphere_node->setPosition(-5, -5, 2.5);
+        sphere_node->setScale(0.02, 0.02, 0.02);
+    }
+
+    // one orbit around the scene over the measured frames, the same for every run
+    void set_camera(size_t frame, size_t frames) {
+        const float angle = Ogre::Math::TWO_PI * float(frame) / float(frames);
+        camera_node->setPosition(21.0f * std::sin(angle), -10.0f + 5.0f * std::sin(2.0f * angle), 21.0f * std::cos(angle));
+        camera_node->lookAt(Ogre::Vector3(0, 0, 0), Ogre::Node::TS_WORLD);
+    }
+
+    double render_frame(Ogre::RenderTexture &target) {
+        const auto begin = std::chrono::steady_clock::now();
+        mRoot->renderOneFrame();
+        // reading a pixel back waits for the gpu to finish the frame
+        Ogre::uint8 pixel[4];
+        target.copyContentsToMemory(Ogre::Box(0, 0, 1, 1), Ogre::PixelBox(1, 1, 1, Ogre::PF_BYTE_RGBA, pixel));
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    void run() {
+        auto &composer = Ogre::CompositorManager::getSingleton();
+        auto &texture_manager = Ogre::TextureManager::getSingleton();
+        for (const auto &[width, height] : options.resolutions) {
+            Ogre::TexturePtr texture = texture_manager.createManual(
+                "ssr_benchmark_target",
+                Ogre::RGN_DEFAULT,
+                Ogre::TEX_TYPE_2D,
+                width,
+                height,
+                0,
+                Ogre::PF_BYTE_RGBA,
+                Ogre::TU_RENDERTARGET
+            );
+            Ogre::RenderTexture &target = *texture->getBuffer()->getRenderTarget();
+            Ogre::Viewport &viewport = *target.addViewport(camera);
+
+            ssr_compositor ssr{};
+            ssr.profile = true;
+            ssr.init(viewport, composer, Ogre::MaterialManager::getSingleton());
+            for (const size_t pipeline : options.pipelines) {
+                for (const size_t preset : options.presets) {
+                    ssr.set_quality(composer, ssr_compositor::quality_presets[preset]);
+                    ssr.enable_pipelines(viewport, composer, pipeline);
+
+                    benchmark_run run{width, height, pipeline, preset, {}, {}};
+                    for (size_t frame = 0; frame < options.warmup; ++frame) {
+                        set_camera(frame, options.warmup);
+                        render_frame(target);
+                        ssr.profiler.frame_ended();
+                    }
+                    ssr.profiler.reset_samples();
+                    for (size_t frame = 0; frame < options.frames; ++frame) {
+                        set_camera(frame, options.frames);
+                        run.frame_ms.push_back(render_frame(target));
+                        ssr.profiler.frame_ended();
+                    }
+                    run.stages = ssr.profiler.reports();
+                    runs.push_back(std::move(run));
+                }
+            }
+            ssr.disable_pipelines(viewport, composer);
+            ssr.deinit(viewport, composer, Ogre::MaterialManager::getSingleton());
+
+            target.removeAllViewports();
+            texture_manager.remove(texture);
+        }
+    }
+};
+
+static void benchmark_write_stats(std::ostream &out, const ssr_profiler::stats &stats) {
+    out << "{\"min\": " << stats.min_ms << ", \"avg\": " << stats.avg_ms << ", \"p99\": " << stats.p99_ms << "}";
+}
+
+static void benchmark_write_json(std::ostream &out, const benchmark_options &options, const std::vector<benchmark_run> &runs) {
+    out << "{\n";
+    out << "  \"render_system\": \"" << options.render_system << "\",\n";
+    out << "  \"frames\": " << options.frames << ",\n";
+    out << "  \"warmup\": " << options.warmup << ",\n";
+    out << "  \"runs\": [";
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const benchmark_run &run = runs[r];
+        std::vector<double> sorted = run.frame_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (const double value : sorted) {
+            sum += value;
+        }
+        auto percentile = [&sorted](size_t p) {
+            return sorted[std::min(sorted.size() - 1, (sorted.size() * p) / 100)];
+        };
+
+        out << (r == 0 ? "\n" : ",\n");
+        out << "    {\n";
+        out << "      \"width\": " << run.width << ",\n";
+        out << "      \"height\": " << run.height << ",\n";
+        out << "      \"pipeline\": \"" << benchmark_pipeline_names[run.pipeline] << "\",\n";
+        out << "      \"preset\": \"" << benchmark_preset_names[run.preset] << "\",\n";
+        out << "      \"frame_ms\": {\"min\": " << sorted.front()
+            << ", \"avg\": " << sum / double(sorted.size())
+            << ", \"p50\": " << percentile(50)
+            << ", \"p95\": " << percentile(95)
+            << ", \"p99\": " << percentile(99)
+            << ", \"max\": " << sorted.back() << "},\n";
+        out << "      \"stages\": [";
+        for (size_t s = 0; s < run.stages.size(); ++s) {
+            const ssr_profiler::report &stage = run.stages[s];
+            out << (s == 0 ? "\n" : ",\n");
+            out << "        {\"name\": \"" << stage.name.substr(stage.name.rfind('/') + 1) << "\", \"gpu_ms\": ";
+            if (stage.gpu_valid) {
+                benchmark_write_stats(out, stage.gpu);
+            } else {
+                out << "null";
+            }
+            out << ", \"cpu_ms\": ";
+            benchmark_write_stats(out, stage.cpu);
+            out << "}";
+        }
+        out << (run.stages.empty() ? "]\n" : "\n      ]\n");
+        out << "    }";
+    }
+    out << (runs.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+}
+
+int main(int argc, char *argv[]) {
+    benchmark_options options{};
+    if (!benchmark_parse(argc, argv, options)) {
+        std::cerr
+            << "usage: ssr_benchmark [--frames N] [--warmup N] [--resolution WxH]...\n"
+            << "                     [--pipeline full|temporal|half|quarter|stochastic|stochastic_quarter]...\n"
+            << "                     [--preset low|medium|high|ultra]...\n"
+            << "                     [--render-system NAME] [--media DIR] [--output FILE]\n";
+        return 2;
+    }
+
+    ssr_benchmark app{options};
+    app.initApp();
+    if (app.getRoot()->getRenderSystem() == nullptr) {
+        std::cerr << "ssr_benchmark: render system \"" << options.render_system << "\" is not available\n";
+        app.closeApp();
+        return 1;
+    }
+    app.run();
+    app.closeApp();
+
+    if (options.output.empty()) {
+        benchmark_write_json(std::cout, options, app.runs);
+    } else {
+        std::ofstream out{options.output};
+        benchmark_write_json(out, options, app.runs);
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+#include "ssr_capture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(ssr_capture::header) <= ssr_capture::plane_alignment, "the header fits before the first plane");
+
+size_t ssr_capture::bytes_per_pixel(plane_format format) {
+    switch (format) {
+    case plane_format::rgba8: return 4;
+    case plane_format::rgba32f: return 16;
+    case plane_format::rg16: return 4;
+    case plane_format::r32f: return 4;
+    case plane_format::r8: return 1;
+    }
+    return 0;
+}
+
+static uint64_t ssr_capture_align(uint64_t offset) {
+    return (offset + ssr_capture::plane_alignment - 1) / ssr_capture::plane_alignment * ssr_capture::plane_alignment;
+}
+
+bool ssr_capture::write(const std::string &path, header header, const std::vector<plane_data> &planes) {
+    if (planes.size() > planes_max) {
+        return false;
+    }
+    header.magic = magic;
+    header.version = version;
+    header.planes_count = uint32_t(planes.size());
+    header.planes = {};
+
+    uint64_t offset = ssr_capture_align(sizeof(header));
+    for (size_t i = 0; i < planes.size(); ++i) {
+        const uint64_t bytes = uint64_t(header.width) * header.height * bytes_per_pixel(planes[i].format);
+        header.planes[i] = {planes[i].kind, planes[i].format, offset, bytes};
+        offset = ssr_capture_align(offset + bytes);
+    }
+
+    std::ofstream out{path, std::ios::out | std::ios::binary | std::ios::trunc};
+    if (!out.is_open()) {
+        return false;
+    }
+    const std::vector<char> padding(plane_alignment, 0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    for (size_t i = 0; i < planes.size(); ++i) {
+        out.write(padding.data(), std::streamsize(header.planes[i].offset - written));
+        out.write(static_cast<const char *>(planes[i].data), std::streamsize(header.planes[i].bytes));
+        written = header.planes[i].offset + header.planes[i].bytes;
+    }
+    return bool(out);
+}
+
+ssr_capture::~ssr_capture() {
+    close();
+}
+
+bool ssr_capture::open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER size{};
+    GetFileSizeEx(file, &size);
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+        mapped = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        mapped_bytes = mapped == nullptr ? 0 : size_t(size.QuadPart);
+    }
+#else
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat status{};
+    if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+        void *address = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address != MAP_FAILED) {
+            mapped = static_cast<const uint8_t *>(address);
+            mapped_bytes = size_t(status.st_size);
+        }
+    }
+    ::close(descriptor);
+#endif
+    if (mapped == nullptr) {
+        close();
+        return false;
+    }
+
+    // every plane has to lie within the file before anything reads it in place
+    bool valid = mapped_bytes >= sizeof(header);
+    if (valid) {
+        const header &h = file_header();
+        valid = h.magic == magic && h.version == version && h.planes_count <= planes_max;
+        for (uint32_t i = 0; valid && i < h.planes_count; ++i) {
+            const plane &p = h.planes[i];
+            valid = p.bytes == uint64_t(h.width) * h.height * bytes_per_pixel(p.format)
+                && p.offset % plane_alignment == 0
+                && p.offset + p.bytes <= mapped_bytes;
+        }
+    }
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+void ssr_capture::close() {
+#ifdef _WIN32
+    if (mapped != nullptr) {
+        UnmapViewOfFile(mapped);
+    }
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+    }
+    if (file != nullptr) {
+        CloseHandle(file);
+    }
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (mapped != nullptr) {
+        munmap(const_cast<uint8_t *>(mapped), mapped_bytes);
+    }
+#endif
+    mapped = nullptr;
+    mapped_bytes = 0;
+}
+
+const ssr_capture::header &ssr_capture::file_header() const {
+    return *reinterpret_cast<const header *>(mapped);
+}
+
+const void *ssr_capture::find(plane_kind kind, plane_format *format) const {
+    if (mapped == nullptr) {
+        return nullptr;
+    }
+    const header &h = file_header();
+    for (uint32_t i = 0; i < h.planes_count; ++i) {
+        if (h.planes[i].kind == kind) {
+            if (format != nullptr) {
+                *format = h.planes[i].format;
+            }
+            return mapped + h.planes[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+// channel c of pixel i as a float, unorm formats scaled to 0..1
+static float ssr_capture_channel(const void *data, ssr_capture::plane_format format, size_t i, size_t c) {
+    switch (format) {
+    case ssr_capture::plane_format::rgba8:
+        return float(static_cast<const uint8_t *>(data)[i * 4 + c]) / 255.0f;
+    case ssr_capture::plane_format::rgba32f:
+        return static_cast<const float *>(data)[i * 4 + c];
+    case ssr_capture::plane_format::rg16: {
+        uint16_t value;
+        std::memcpy(&value, static_cast<const uint8_t *>(data) + (i * 2 + c) * 2, sizeof(value));
+        return float(value) / 65535.0f;
+    }
+    case ssr_capture::plane_format::r32f: {
+        float value;
+        std::memcpy(&value, static_cast<const uint8_t *>(data) + i * 4, sizeof(value));
+        return value;
+    }
+    case ssr_capture::plane_format::r8:
+        return float(static_cast<const uint8_t *>(data)[i]) / 255.0f;
+    }
+    return 0.0f;
+}
+
+static std::vector<float> ssr_capture_rgba(const ssr_capture &capture, ssr_capture::plane_kind kind) {
+    ssr_capture::plane_format format{};
+    const void *data = capture.find(kind, &format);
+    if (data == nullptr) {
+        return {};
+    }
+    const size_t pixels = size_t(capture.file_header().width) * capture.file_header().height;
+    std::vector<float> result(pixels * 4);
+    for (size_t i = 0; i < pixels; ++i) {
+        for (size_t c = 0; c < 4; ++c) {
+            result[i * 4 + c] = ssr_capture_channel(data, format, i, c);
+        }
+    }
+    return result;
+}
+
+std::vector<float> ssr_capture::ndr_unpacked() const {
+    if (find(plane_kind::ndr) != nullptr) {
+        return ssr_capture_rgba(*this, plane_kind::ndr);
+    }
+    plane_format normal_format{};
+    plane_format depth_format{};
+    plane_format roughness_format{};
+    const void *normal = find(plane_kind::ndr_normal_octahedral, &normal_format);
+    const void *depth = find(plane_kind::ndr_depth, &depth_format);
+    const void *roughness = find(plane_kind::ndr_roughness, &roughness_format);
+    if (normal == nullptr || depth == nullptr || roughness == nullptr) {
+        return {};
+    }
+
+    const size_t pixels = size_t(file_header().width) * file_header().height;
+    std::vector<float> result(pixels * 4);
+    for (size_t i = 0; i < pixels; ++i) {
+        // normal_from_octahedral_unorm of ssr_normal_depth_rough.glsl, the unpacked layout keeps xy only
+        float x = ssr_capture_channel(normal, normal_format, i, 0) * 2.0f - 1.0f;
+        float y = ssr_capture_channel(normal, normal_format, i, 1) * 2.0f - 1.0f;
+        const float z = 1.0f - std::abs(x) - std::abs(y);
+        const float fold = std::clamp(-z, 0.0f, 1.0f);
+        x += x >= 0.0f ? -fold : fold;
+        y += y >= 0.0f ? -fold : fold;
+        const float length = std::sqrt(x * x + y * y + z * z);
+
+        result[i * 4 + 0] = x / length;
+        result[i * 4 + 1] = y / length;
+        result[i * 4 + 2] = ssr_capture_channel(depth, depth_format, i, 0);
+        result[i * 4 + 3] = ssr_capture_channel(roughness, roughness_format, i, 0);
+    }
+    return result;
+}
+
+std::vector<float> ssr_capture::scene_colour() const {
+    return ssr_capture_rgba(*this, plane_kind::scene_colour);
+}
+
+std::vector<float> ssr_capture::colour() const {
+    return ssr_capture_rgba(*this, plane_kind::colour);
+}
@@ -0,0 +1,107 @@
+#ifndef SSR_CAPTURE_HPP
+#define SSR_CAPTURE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one captured frame of the raytrace inputs: a fixed size header followed by raw planes,
+// each plane starting on a plane_alignment boundary so a mapped file is read in place
+// written by ssr_compositor::capture, read back by ssr_replay
+struct ssr_capture {
+    static constexpr std::array<char, 4> magic{'S', 'S', 'R', 'C'};
+    static constexpr uint32_t version = 1;
+    static constexpr size_t planes_max = 8;
+    static constexpr size_t plane_alignment = 4096;
+
+    enum class plane_kind : uint32_t {
+        scene_colour,
+        // unpacked normal_depth_rough
+        ndr,
+        // packed normal_depth_rough planes
+        ndr_normal_octahedral,
+        ndr_depth,
+        ndr_roughness,
+        // replay outputs, written by ssr_replay, hit_uv only by its ssr_cpu reference
+        colour,
+        hit_uv,
+    };
+    enum class plane_format : uint32_t {
+        rgba8,
+        rgba32f,
+        rg16,
+        r32f,
+        r8,
+    };
+    struct plane {
+        plane_kind kind;
+        plane_format format;
+        // rows are tightly packed, top to bottom
+        uint64_t offset;
+        uint64_t bytes;
+    };
+    // the raytrace knobs the frame was rendered with
+    struct quality {
+        uint32_t steps_max;
+        uint32_t steps_bsearch_max;
+        float distance_max_vs;
+        float thickness_radius_vs;
+        uint32_t frustum_clip_enable;
+        uint32_t bsearch_enable;
+    };
+    struct header {
+        std::array<char, 4> magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t planes_count;
+        // raytrace_frame of ssr/constants, the seed of the rays, 0 in captures from before it existed
+        uint32_t raytrace_frame;
+        // row major, as held by ssr/constants
+        std::array<float, 16> projection_matrix;
+        std::array<float, 16> i_projection_matrix;
+        std::array<float, 16> i_view_matrix;
+        float near_clip_plane;
+        float far_clip_plane;
+        quality raytrace;
+        std::array<plane, planes_max> planes;
+    };
+    // plane contents handed to write, offsets and sizes are filled in from width and height
+    struct plane_data {
+        plane_kind kind;
+        plane_format format;
+        const void *data;
+    };
+
+    static size_t bytes_per_pixel(plane_format format);
+    static bool write(const std::string &path, header header, const std::vector<plane_data> &planes);
+
+    ssr_capture() = default;
+    ~ssr_capture();
+    ssr_capture(const ssr_capture &) = delete;
+    ssr_capture &operator=(const ssr_capture &) = delete;
+
+    // maps path read only, false when it is not a capture of this version
+    bool open(const std::string &path);
+    void close();
+
+    const header &file_header() const;
+    const void *find(plane_kind kind, plane_format *format = nullptr) const;
+
+    // 4 floats per pixel in the layout ssr_cpu::frame reads, empty when the planes are missing
+    std::vector<float> ndr_unpacked() const;
+    std::vector<float> scene_colour() const;
+    std::vector<float> colour() const;
+
+private:
+    const uint8_t *mapped = nullptr;
+    size_t mapped_bytes = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+#endif
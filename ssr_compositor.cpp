@@ -1,4 +1,9 @@
 #include "ssr_compositor.hpp"
+#include "ssr_ndr_render_state.hpp"
+#include "ssr_rt_pool.hpp"
+#include "ssr_profiler.hpp"
+#include "ssr_capture.hpp"
+#include "ssr_governor.hpp"
 #include <OgreCompositorManager.h>
 #include <OgreTextureManager.h>
 #include <OgreViewport.h>
@@ -6,155 +11,758 @@
 #include <OgreTechnique.h>
 #include <OgreCompositor.h>
 #include <OgreCompositionTargetPass.h>
+#include <OgreCompositorChain.h>
+#include <OgreGpuProgramManager.h>
+#include <OgreLogManager.h>
 #include <OgreShaderGenerator.h>
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreCamera.h>
+#include <OgreRoot.h>
+#include <OgreWorkQueue.h>
+#include <OgreEntity.h>
+#include <OgreMovableObject.h>
+#include <OgreSubEntity.h>
+#include <OgreSubMesh.h>
+#include <OgreInstanceBatchHW.h>
 
+#include <algorithm>
 #include <array>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
 #include <string_view>
+#include <utility>
+#include <vector>
 
-static const std::string texture_group_name = "General";
 
 static const std::string rt_out_ndr_name = "ssr_normal_depth_rough";
 static const std::string rt_in_scene_name = "ssr_scene";
-static const std::string rt_in_out_temp_name = "ssr_temp";
+static const std::string rt_reflection_name = "ssr_reflection";
+static const std::string rt_reflection_resolved_name = "ssr_reflection_resolved";
+static const std::string rt_history_name = "ssr_history";
+static const std::string rt_hiz_name_prefix = "ssr_hiz_";
+static const std::string rt_gbuffer_name = "ssr_gbuffer";
+static const std::string rt_tiles_name = "ssr_tiles";
+static const std::string rt_ray_hit_name = "ssr_ray_hit";
+static const std::string rt_reflection_denoise_name = "ssr_reflection_denoise";
+static const std::string rt_scene_blur_name_prefix = "ssr_scene_blur_";
 
 static const std::string material_ndr_name = "ssr/output_normal_depth_rough";
+static const std::string material_ndr_skinning_name = "ssr/output_normal_depth_rough_skinning";
+static const std::string material_ndr_instancing_name = "ssr/output_normal_depth_rough_instancing";
 static const std::string material_raytrace_name = "ssr/output_raytrace";
+static const std::string material_raytrace_compute_name = "ssr/output_raytrace_compute";
+static const std::string material_hiz_name = "ssr/output_hiz";
+static const std::string material_hiz_from_ndr_name = "ssr/output_hiz_from_ndr";
+static const std::string material_temporal_name = "ssr/output_temporal";
+static const std::string material_upsample_name = "ssr/output_upsample";
+static const std::string material_gbuffer_clear_name = "ssr/output_gbuffer_clear";
+static const std::string material_tiles_name = "ssr/output_tiles";
+static const std::string material_scene_blur_name = "ssr/output_scene_blur";
+static const std::string material_resolve_name = "ssr/output_resolve";
+static const std::string material_denoise_name = "ssr/output_denoise";
 static const std::string material_copyback_name = "Ogre/Compositor/Copyback";
 
 static const std::string scheme_ndr_name = "ssr_output_normal_depth_rough_scheme";
 
 
-static auto ssr_compositor_init_textures(
-    Ogre::Viewport &viewport,
-    Ogre::TextureManager &texture_manager
-) {
-    Ogre::TexturePtr normal_depth_rough = texture_manager.createManual(
-        rt_out_ndr_name,
-        texture_group_name,
-        Ogre::TEX_TYPE_2D,
-        viewport.getActualWidth(),
-        viewport.getActualHeight(),
-        0,
-        Ogre::PF_FLOAT32_RGBA,
-        Ogre::TU_RENDERTARGET | Ogre::TU_STATIC_WRITE_ONLY
+// clones material_name with the gpu programs of every pass rebuilt under extra preprocessor defines
+// permutations are named "<defines>/<name>" and cached by the material and gpu program managers
+static Ogre::MaterialPtr ssr_compositor_material_permutation(const std::string &material_name, const std::string &defines) {
+    auto &material_manager = Ogre::MaterialManager::getSingleton();
+    auto &program_manager = Ogre::GpuProgramManager::getSingleton();
+    if (defines.empty()) {
+        Ogre::MaterialPtr material = material_manager.getByName(
+            material_name,
+            Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME
+        );
+        material->load();
+        return material;
+    }
+    const std::string permutation_name = defines + "/" + material_name;
+
+    Ogre::MaterialPtr permutation = material_manager.getByName(
+        permutation_name,
+        Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME
     );
+    if (permutation) {
+        return permutation;
+    }
 
-    Ogre::TexturePtr temp = texture_manager.createManual(
-        rt_in_out_temp_name,
-        texture_group_name,
-        Ogre::TEX_TYPE_2D,
-        viewport.getActualWidth(),
-        viewport.getActualHeight(),
-        0,
-        Ogre::PF_R8G8B8,
-        Ogre::TU_RENDERTARGET | Ogre::TU_STATIC_WRITE_ONLY
+    Ogre::MaterialPtr material = material_manager.getByName(
+        material_name,
+        Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME
     );
+    material->load();
+    permutation = material->clone(permutation_name);
+    for (Ogre::Technique *technique : permutation->getTechniques()) {
+        for (Ogre::Pass *pass : technique->getPasses()) {
+            for (const auto type : {Ogre::GPT_VERTEX_PROGRAM, Ogre::GPT_FRAGMENT_PROGRAM, Ogre::GPT_COMPUTE_PROGRAM}) {
+                if (!pass->hasGpuProgram(type)) {
+                    continue;
+                }
+                const Ogre::GpuProgramPtr &program = pass->getGpuProgram(type);
+                const std::string program_name = defines + "/" + program->getName();
+
+                Ogre::GpuProgramPtr program_permutation = program_manager.getByName(program_name, program->getGroup());
+                if (!program_permutation) {
+                    program_permutation = program_manager.createProgram(
+                        program_name,
+                        program->getGroup(),
+                        program->getLanguage(),
+                        type
+                    );
+                    program_permutation->setSourceFile(program->getSourceFile());
+                    program_permutation->setSyntaxCode(program->getSyntaxCode());
+
+                    const std::string program_defines = program->getParameter("preprocessor_defines");
+                    program_permutation->setParameter(
+                        "preprocessor_defines",
+                        program_defines.empty() ? defines : program_defines + "," + defines
+                    );
+                    // entities and instance managers look for these before animating or batching on the gpu
+                    program_permutation->setSkeletalAnimationIncluded(program->isSkeletalAnimationIncluded());
+                    program_permutation->setInstancingIncluded(program->isInstancingIncluded());
+                }
+
+                Ogre::GpuProgramParametersSharedPtr parameters = pass->getGpuProgramParameters(type);
+                pass->setGpuProgram(type, program_permutation);
+                pass->getGpuProgramParameters(type)->copyMatchingNamedConstantsFrom(*parameters);
+            }
+        }
+    }
+    permutation->load();
+    return permutation;
+}
+
+static std::string ssr_compositor_defines(std::initializer_list<std::string_view> defines) {
+    std::string joined{};
+    for (const auto define : defines) {
+        if (define.empty()) {
+            continue;
+        }
+        if (!joined.empty()) {
+            joined += ",";
+        }
+        joined += define;
+    }
+    return joined;
+}
+
+// parameters of the program that samples the inputs, compute materials have no fragment program
+static Ogre::GpuProgramParameters &ssr_compositor_program_parameters(Ogre::Material &material) {
+    Ogre::Pass &pass = *material.getTechnique(0)->getPass(0);
+    return pass.hasComputeProgram() ? *pass.getComputeProgramParameters() : *pass.getFragmentProgramParameters();
+}
+
+// units of the samplers the material script can't name, because some permutations optimise them out
+static void ssr_compositor_bind_samplers(
+    Ogre::Material &material,
+    std::initializer_list<std::pair<const char *, size_t>> samplers
+) {
+    Ogre::GpuProgramParameters &parameters = ssr_compositor_program_parameters(material);
+    for (const auto &[sampler, unit] : samplers) {
+        if (parameters._findNamedConstantDefinition(sampler)) {
+            parameters.setNamedConstant(sampler, int(unit));
+        }
+    }
+}
+
+static void ssr_compositor_set_scene_input(const ssr_compositor &self, Ogre::CompositionPass &pass, size_t unit) {
+    if (self.ndr_single_pass) {
+        pass.setInput(unit, rt_gbuffer_name, ssr_compositor::gbuffer_scene);
+    } else {
+        pass.setInput(unit, rt_in_scene_name);
+    }
+}
+
+// packed normal_depth_rough binds its depth and roughness planes to planes_unit onwards,
+// past the units the material uses for itself
+static void ssr_compositor_set_ndr_inputs(
+    const ssr_compositor &self,
+    Ogre::CompositionPass &pass,
+    size_t ndr_unit,
+    size_t planes_unit
+) {
+    if (self.ndr_single_pass) {
+        pass.setInput(ndr_unit, rt_gbuffer_name, ssr_compositor::gbuffer_ndr);
+        return;
+    }
+    pass.setInput(ndr_unit, rt_out_ndr_name, ssr_compositor::ndr_packed_normal);
+    if (!self.ndr_packed) {
+        return;
+    }
+    pass.setInput(planes_unit, rt_out_ndr_name, ssr_compositor::ndr_packed_depth);
+    pass.setInput(planes_unit + 1, rt_out_ndr_name, ssr_compositor::ndr_packed_roughness);
 
-    Ogre::TexturePtr scene = texture_manager.createManual(
-        rt_in_scene_name,
-        texture_group_name,
-        Ogre::TEX_TYPE_2D,
-        viewport.getActualWidth(),
-        viewport.getActualHeight(),
-        0,
-        Ogre::PF_R8G8B8,
-        Ogre::TU_RENDERTARGET | Ogre::TU_STATIC_WRITE_ONLY
+    ssr_compositor_bind_samplers(*pass.getMaterial(), {
+        {"ndr_depth_texture", planes_unit},
+        {"ndr_roughness_texture", planes_unit + 1},
+    });
+}
+
+static std::string ssr_compositor_quality_defines(const ssr_compositor::quality_desc &quality) {
+    return ssr_compositor_defines({
+        "SSR_STEPS_MAX=" + std::to_string(quality.steps_max),
+        "SSR_STEPS_BSEARCH_MAX=" + std::to_string(quality.steps_bsearch_max),
+        "SSR_STEPS_HIZ_MAX=" + std::to_string(quality.steps_hiz_max),
+        "SSR_DISTANCE_MAX_VS=" + std::to_string(quality.distance_max_vs),
+        "SSR_THICKNESS_RADIUS_VS=" + std::to_string(quality.thickness_radius_vs),
+        "SSR_FRUSTUM_CLIP_ENABLE=" + std::to_string(int(quality.frustum_clip_enable)),
+        "SSR_BSEARCH_ENABLE=" + std::to_string(int(quality.bsearch_enable)),
+        "SSR_HIZ_TRAVERSAL_ENABLE=" + std::to_string(int(quality.hiz_traversal_enable)),
+        "SSR_DDA_ENABLE=" + std::to_string(int(quality.dda_enable)),
+    });
+}
+
+static std::string ssr_compositor_tile_defines() {
+    return ssr_compositor_defines({
+        "SSR_TILE_CLASSIFY_ENABLE=1",
+        "SSR_TILE_SIZE=" + std::to_string(ssr_compositor::tile_size),
+    });
+}
+
+// raytrace inputs past the scene, normal_depth_rough and hiz levels
+static constexpr size_t ssr_compositor_raytrace_planes_unit = 2 + ssr_compositor::hiz_levels;
+static constexpr size_t ssr_compositor_raytrace_tiles_unit = ssr_compositor_raytrace_planes_unit + 2;
+static constexpr size_t ssr_compositor_raytrace_scene_blur_unit = ssr_compositor_raytrace_tiles_unit + 1;
+// image the compute raytrace stores into
+static constexpr size_t ssr_compositor_raytrace_output_unit =
+    ssr_compositor_raytrace_scene_blur_unit + ssr_compositor::scene_blur_levels;
+
+// anything past a plain full resolution trace keeps the reflection apart until the final composite
+// the denoise blur needs it too, only paid for when it's turned on
+static bool ssr_compositor_reflection_separate(const ssr_compositor &self, const ssr_compositor::pipeline_desc &desc) {
+    return desc.trace_scale != 1.0f || desc.temporal || self.denoise;
+}
+
+// image stores need a target of their own, the final output is left to the quad
+static bool ssr_compositor_raytrace_compute(const ssr_compositor &self, const ssr_compositor::pipeline_desc &desc) {
+    return self.raytrace_compute && ssr_compositor_reflection_separate(self, desc);
+}
+
+// the composited trace has no reflection target to leave a part of
+static bool ssr_compositor_dynamic_resolution(const ssr_compositor &self, const ssr_compositor::pipeline_desc &desc) {
+    return self.dynamic_resolution && ssr_compositor_reflection_separate(self, desc);
+}
+
+// the resolve of reused rays already filters rough reflections
+static bool ssr_compositor_glossy(const ssr_compositor &self, const ssr_compositor::pipeline_desc &desc) {
+    return self.glossy && !desc.ray_reuse;
+}
+
+static Ogre::MaterialPtr ssr_compositor_raytrace_material(
+    const ssr_compositor &self,
+    const ssr_compositor::pipeline_desc &desc,
+    const ssr_compositor::quality_desc &quality
+) {
+    Ogre::MaterialPtr material = ssr_compositor_material_permutation(
+        ssr_compositor_raytrace_compute(self, desc) ? material_raytrace_compute_name : material_raytrace_name,
+        ssr_compositor_defines({
+            self.ndr_packed ? "SSR_NDR_PACKED" : "",
+            ssr_compositor_reflection_separate(self, desc) ? "SSR_OUTPUT_REFLECTION" : "",
+            desc.ray_reuse ? "SSR_OUTPUT_RAY_HIT" : "",
+            ssr_compositor_quality_defines(quality),
+            self.tile_classify ? ssr_compositor_tile_defines() : "",
+            ssr_compositor_glossy(self, desc) ? "SSR_GLOSSY_ENABLE=1" : "",
+            desc.temporal ? "SSR_TEMPORAL_ENABLE=1" : "",
+            ssr_compositor_dynamic_resolution(self, desc) ? "SSR_DYNAMIC_RESOLUTION" : "",
+        })
     );
-    return std::array{normal_depth_rough, scene, temp};
+    ssr_logic::attach_constants(ssr_compositor_program_parameters(*material));
+    // set_quality swaps in permutations created after the pipeline, their samplers are bound here too
+    ssr_compositor_bind_samplers(*material, {
+        {"ndr_depth_texture", ssr_compositor_raytrace_planes_unit},
+        {"ndr_roughness_texture", ssr_compositor_raytrace_planes_unit + 1},
+        {"tiles_texture", ssr_compositor_raytrace_tiles_unit},
+        {"output_image", ssr_compositor_raytrace_output_unit},
+    });
+    for (size_t level = 1; level <= ssr_compositor::scene_blur_levels; ++level) {
+        const std::string sampler = "scene_blur_" + std::to_string(level) + "_texture";
+        ssr_compositor_bind_samplers(*material, {{sampler.c_str(), ssr_compositor_raytrace_scene_blur_unit + level - 1}});
+    }
+    return material;
+}
+
+// quad and compute passes only, the profiler timestamps carry identifiers of their own
+static Ogre::CompositionPass *ssr_compositor_find_pass(const Ogre::CompositionTechnique &technique, Ogre::uint32 identifier) {
+    auto find = [identifier](const Ogre::CompositionTargetPass &target_pass) -> Ogre::CompositionPass * {
+        for (Ogre::CompositionPass *pass : target_pass.getPasses()) {
+            const auto type = pass->getType();
+            if ((type == Ogre::CompositionPass::PT_RENDERQUAD || type == Ogre::CompositionPass::PT_COMPUTE)
+                && pass->getIdentifier() == identifier) {
+                return pass;
+            }
+        }
+        return nullptr;
+    };
+    for (const Ogre::CompositionTargetPass *target_pass : technique.getTargetPasses()) {
+        if (Ogre::CompositionPass *pass = find(*target_pass)) {
+            return pass;
+        }
+    }
+    return find(*technique.getOutputTargetPass());
+}
+
+// the timed passes of target_pass follow this one, ssr_compositor_profile_end closes every bracket
+static void ssr_compositor_profile_begin(
+    const ssr_compositor &self,
+    Ogre::CompositionTargetPass &target_pass,
+    const std::string &label
+) {
+    if (!self.profile) {
+        return;
+    }
+    Ogre::CompositionPass *pass = target_pass.createPass(Ogre::CompositionPass::PT_RENDERCUSTOM);
+    pass->setCustomType(ssr_profiler::custom_type_prefix + label);
+    pass->setIdentifier(ssr_profiler::timestamp_begin);
+}
+
+static void ssr_compositor_profile_end(Ogre::CompositionTechnique &technique) {
+    auto profile_end = [](Ogre::CompositionTargetPass &target_pass) {
+        if (target_pass.getPasses().empty()) {
+            return;
+        }
+        const Ogre::CompositionPass &first = *target_pass.getPasses().front();
+        const bool timed = first.getType() == Ogre::CompositionPass::PT_RENDERCUSTOM
+            && first.getIdentifier() == ssr_profiler::timestamp_begin
+            && first.getCustomType().starts_with(ssr_profiler::custom_type_prefix);
+        if (!timed) {
+            return;
+        }
+        Ogre::CompositionPass *pass = target_pass.createPass(Ogre::CompositionPass::PT_RENDERCUSTOM);
+        pass->setCustomType(first.getCustomType());
+        pass->setIdentifier(ssr_profiler::timestamp_end);
+    };
+    for (Ogre::CompositionTargetPass *target_pass : technique.getTargetPasses()) {
+        profile_end(*target_pass);
+    }
+    profile_end(*technique.getOutputTargetPass());
 }
 
-static auto ssr_compositor_create_pipelines(ssr_compositor &self, Ogre::Viewport &viewport, Ogre::CompositorManager &composer) {
-    (void)viewport;
+// the scissor a render scaled pass of target_pass leaves on goes off before anything else renders
+static void ssr_compositor_scissor_reset(
+    const ssr_compositor &self,
+    const ssr_compositor::pipeline_desc &desc,
+    Ogre::CompositionTargetPass &target_pass
+) {
+    if (!ssr_compositor_dynamic_resolution(self, desc)) {
+        return;
+    }
+    Ogre::CompositionPass *pass = target_pass.createPass(Ogre::CompositionPass::PT_RENDERCUSTOM);
+    pass->setCustomType(ssr_logic::scissor_reset_type);
+}
+
+static std::string ssr_compositor_hiz_name(size_t level) {
+    return rt_hiz_name_prefix + std::to_string(level);
+}
+
+// only the hi-z traversal reads the pyramid, without it its passes render once when the chain compiles
+static void ssr_compositor_set_hiz_enabled(Ogre::CompositionTechnique &technique, bool enabled) {
+    for (Ogre::CompositionTargetPass *target_pass : technique.getTargetPasses()) {
+        if (target_pass->getOutputName().starts_with(rt_hiz_name_prefix)) {
+            target_pass->setOnlyInitial(!enabled);
+        }
+    }
+}
+
+static std::string ssr_compositor_scene_blur_name(size_t level) {
+    return rt_scene_blur_name_prefix + std::to_string(level);
+}
+
+static Ogre::CompositorPtr ssr_compositor_create_pipeline(
+    const ssr_compositor &self,
+    const ssr_compositor::pipeline_desc &desc,
+    Ogre::CompositorManager &composer
+) {
+    const std::string_view ndr_define = self.ndr_packed ? "SSR_NDR_PACKED" : "";
+    const bool reflection_separate = ssr_compositor_reflection_separate(self, desc);
+    // the passes filtering the reflection read the render scale with the camera constants
+    const std::string reflection_defines = ssr_compositor_defines({
+        ndr_define,
+        ssr_compositor_dynamic_resolution(self, desc) ? "SSR_DYNAMIC_RESOLUTION" : "",
+    });
     Ogre::CompositorPtr compositor = composer.create(
-        self.ssr.name,
+        ssr_logic::name + std::string(desc.name),
         Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME
     ); {
         Ogre::CompositionTechnique *pipeline = compositor->createTechnique(); {
-            auto &out_ndr_texture = *pipeline->createTextureDefinition(rt_out_ndr_name); {
-                out_ndr_texture.width = 0;
-                out_ndr_texture.height = 0;
-                out_ndr_texture.formatList.push_back(Ogre::PF_FLOAT32_RGBA);
+            if (self.ndr_single_pass) {
+                auto &gbuffer_texture = *pipeline->createTextureDefinition(rt_gbuffer_name); {
+                    gbuffer_texture.width = 0;
+                    gbuffer_texture.height = 0;
+                    gbuffer_texture.formatList.push_back(Ogre::PF_R8G8B8);
+                    gbuffer_texture.formatList.push_back(Ogre::PF_FLOAT32_RGBA);
+                }
+            } else {
+                auto &out_ndr_texture = *pipeline->createTextureDefinition(rt_out_ndr_name); {
+                    out_ndr_texture.width = 0;
+                    out_ndr_texture.height = 0;
+                    if (self.ndr_packed) {
+                        out_ndr_texture.formatList.assign(
+                            ssr_compositor::ndr_packed_formats.begin(),
+                            ssr_compositor::ndr_packed_formats.end()
+                        );
+                    } else {
+                        out_ndr_texture.formatList.push_back(Ogre::PF_FLOAT32_RGBA);
+                    }
+                }
+
+                auto &in_scene_texture = *pipeline->createTextureDefinition(rt_in_scene_name); {
+                    in_scene_texture.width = 0;
+                    in_scene_texture.height = 0;
+                    in_scene_texture.formatList.push_back(Ogre::PF_R8G8B8);
+                }
             }
 
-            auto &in_scene_texture = *pipeline->createTextureDefinition(rt_in_scene_name); {
-                in_scene_texture.width = 0;
-                in_scene_texture.height = 0;
-                in_scene_texture.formatList.push_back(Ogre::PF_R8G8B8);
+            if (reflection_separate) {
+                // the resolve of reused rays shades the reflection back at full resolution
+                const float reflection_scale = desc.ray_reuse ? 1.0f : desc.trace_scale;
+                if (desc.ray_reuse) {
+                    auto &ray_hit_texture = *pipeline->createTextureDefinition(rt_ray_hit_name); {
+                        ray_hit_texture.width = 0;
+                        ray_hit_texture.height = 0;
+                        ray_hit_texture.widthFactor = desc.trace_scale;
+                        ray_hit_texture.heightFactor = desc.trace_scale;
+                        ray_hit_texture.formatList.push_back(Ogre::PF_FLOAT32_RGBA);
+                    }
+                }
+                auto &reflection_texture = *pipeline->createTextureDefinition(rt_reflection_name); {
+                    reflection_texture.width = 0;
+                    reflection_texture.height = 0;
+                    reflection_texture.widthFactor = reflection_scale;
+                    reflection_texture.heightFactor = reflection_scale;
+                    reflection_texture.formatList.push_back(Ogre::PF_FLOAT16_RGBA);
+                }
+                if (self.denoise) {
+                    auto &denoise_texture = *pipeline->createTextureDefinition(rt_reflection_denoise_name); {
+                        denoise_texture.width = 0;
+                        denoise_texture.height = 0;
+                        denoise_texture.widthFactor = reflection_scale;
+                        denoise_texture.heightFactor = reflection_scale;
+                        denoise_texture.formatList.push_back(Ogre::PF_FLOAT16_RGBA);
+                    }
+                }
+                if (desc.temporal) {
+                    for (const auto &name : {rt_reflection_resolved_name, rt_history_name}) {
+                        auto &temporal_texture = *pipeline->createTextureDefinition(name); {
+                            temporal_texture.width = 0;
+                            temporal_texture.height = 0;
+                            temporal_texture.widthFactor = reflection_scale;
+                            temporal_texture.heightFactor = reflection_scale;
+                            temporal_texture.formatList.push_back(Ogre::PF_FLOAT16_RGBA);
+                        }
+                    }
+                }
             }
 
-            auto &in_out_temp_texture = *pipeline->createTextureDefinition(rt_in_out_temp_name); {
-                in_out_temp_texture.width = 0;
-                in_out_temp_texture.height = 0;
-                in_out_temp_texture.formatList.push_back(Ogre::PF_R8G8B8);
+            for (size_t level = 1; level <= ssr_compositor::hiz_levels; ++level) {
+                auto &hiz_texture = *pipeline->createTextureDefinition(ssr_compositor_hiz_name(level)); {
+                    hiz_texture.width = 0;
+                    hiz_texture.height = 0;
+                    hiz_texture.widthFactor = 1.0f / float(1u << level);
+                    hiz_texture.heightFactor = 1.0f / float(1u << level);
+                    hiz_texture.formatList.push_back(Ogre::PF_FLOAT32_R);
+                }
             }
 
-            // copy scene colour
-            {
-                Ogre::CompositionTargetPass &pass_scene = *pipeline->createTargetPass();
-                pass_scene.setInputMode(Ogre::CompositionTargetPass::IM_PREVIOUS);
-                pass_scene.setOutputName(rt_in_scene_name);
+            if (ssr_compositor_glossy(self, desc)) {
+                for (size_t level = 1; level <= ssr_compositor::scene_blur_levels; ++level) {
+                    auto &scene_blur_texture = *pipeline->createTextureDefinition(ssr_compositor_scene_blur_name(level)); {
+                        scene_blur_texture.width = 0;
+                        scene_blur_texture.height = 0;
+                        scene_blur_texture.widthFactor = 1.0f / float(1u << level);
+                        scene_blur_texture.heightFactor = 1.0f / float(1u << level);
+                        scene_blur_texture.formatList.push_back(Ogre::PF_R8G8B8);
+                    }
+                }
             }
-            // clear normal_depth_rough
-            {
-                Ogre::CompositionTargetPass &pass_clear = *pipeline->createTargetPass();
-                pass_clear.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
-                pass_clear.setOutputName(rt_out_ndr_name); {
-                    Ogre::CompositionPass *pass = pass_clear.createPass(Ogre::CompositionPass::PT_CLEAR);
-                    pass->setClearColour(Ogre::ColourValue(0, 0, 1, 1));
-                    pass->setClearDepth(1.0f);
-                    pass->setClearBuffers(Ogre::FBT_COLOUR | Ogre::FBT_DEPTH);
+
+            if (self.tile_classify) {
+                auto &tiles_texture = *pipeline->createTextureDefinition(rt_tiles_name); {
+                    tiles_texture.width = 0;
+                    tiles_texture.height = 0;
+                    tiles_texture.widthFactor = 1.0f / float(ssr_compositor::tile_size);
+                    tiles_texture.heightFactor = 1.0f / float(ssr_compositor::tile_size);
+                    tiles_texture.formatList.push_back(Ogre::PF_R8);
                 }
             }
-            // render scene normal, depth and rough
-            {
-                Ogre::CompositionTargetPass &pass_ndr = *pipeline->createTargetPass();
-                pass_ndr.setMaterialScheme(scheme_ndr_name);
-                pass_ndr.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
-                pass_ndr.setOutputName(rt_out_ndr_name); {
-                    Ogre::CompositionPass *pass = pass_ndr.createPass(Ogre::CompositionPass::PT_RENDERSCENE);
-                    (void)pass;
-                    // pass->setMaterialName(material_ndr_name);
-                    // pass->setMaterialScheme(scheme_ndr_name);
+
+            // history starts empty whenever the pipeline resources are (re)created
+            if (desc.temporal) {
+                Ogre::CompositionTargetPass &pass_history_clear = *pipeline->createTargetPass();
+                pass_history_clear.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_history_clear.setOnlyInitial(true);
+                pass_history_clear.setOutputName(rt_history_name); {
+                    Ogre::CompositionPass *pass = pass_history_clear.createPass(Ogre::CompositionPass::PT_CLEAR);
+                    pass->setClearColour(Ogre::ColourValue(0, 0, 0, 0));
+                    pass->setClearBuffers(Ogre::FBT_COLOUR);
+                }
+            }
+            if (self.ndr_single_pass) {
+                // one render_scene fills the scene colour and normal_depth_rough planes together,
+                // the quad writes each plane its own clear value
+                Ogre::CompositionTargetPass &pass_gbuffer = *pipeline->createTargetPass();
+                pass_gbuffer.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_gbuffer.setOutputName(rt_gbuffer_name);
+                ssr_compositor_profile_begin(self, pass_gbuffer, "gbuffer"); {
+                    Ogre::CompositionPass *pass_clear = pass_gbuffer.createPass(Ogre::CompositionPass::PT_CLEAR);
+                    pass_clear->setClearDepth(1.0f);
+                    pass_clear->setClearBuffers(Ogre::FBT_DEPTH | Ogre::FBT_STENCIL);
+
+                    Ogre::CompositionPass *pass_clear_planes = pass_gbuffer.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    pass_clear_planes->setMaterialName(material_gbuffer_clear_name);
+                    pass_clear_planes->setIdentifier(ssr_logic::pass_id_gbuffer_clear);
+
+                    Ogre::CompositionPass *pass_scene = pass_gbuffer.createPass(Ogre::CompositionPass::PT_RENDERSCENE);
+                    (void)pass_scene;
+                }
+            } else {
+                // the original scene renders straight into scene colour, there is no copy
+                {
+                    Ogre::CompositionTargetPass &pass_scene = *pipeline->createTargetPass();
+                    pass_scene.setInputMode(Ogre::CompositionTargetPass::IM_PREVIOUS);
+                    pass_scene.setOutputName(rt_in_scene_name);
+                }
+                // clear normal_depth_rough
+                {
+                    Ogre::CompositionTargetPass &pass_clear = *pipeline->createTargetPass();
+                    pass_clear.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                    pass_clear.setOutputName(rt_out_ndr_name);
+                    ssr_compositor_profile_begin(self, pass_clear, "ndr_clear"); {
+                        Ogre::CompositionPass *pass = pass_clear.createPass(Ogre::CompositionPass::PT_CLEAR);
+                        // far depth and full roughness, packed targets share the colour across every plane
+                        pass->setClearColour(self.ndr_packed ? Ogre::ColourValue(1, 1, 1, 1) : Ogre::ColourValue(0, 0, 1, 1));
+                        pass->setClearDepth(1.0f);
+                        pass->setClearBuffers(Ogre::FBT_COLOUR | Ogre::FBT_DEPTH);
+                    }
+                }
+                // render scene normal, depth and rough
+                {
+                    Ogre::CompositionTargetPass &pass_ndr = *pipeline->createTargetPass();
+                    pass_ndr.setMaterialScheme(scheme_ndr_name);
+                    pass_ndr.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                    pass_ndr.setOutputName(rt_out_ndr_name);
+                    // the shadow textures of the frame are not read here
+                    pass_ndr.setShadowsEnabled(false);
+                    pass_ndr.setVisibilityMask(self.ndr_visibility_mask);
+                    ssr_compositor_profile_begin(self, pass_ndr, "ndr"); {
+                        Ogre::CompositionPass *pass = pass_ndr.createPass(Ogre::CompositionPass::PT_RENDERSCENE);
+                        pass->setFirstRenderQueue(self.ndr_first_render_queue);
+                        pass->setLastRenderQueue(self.ndr_last_render_queue);
+                        // pass->setMaterialName(material_ndr_name);
+                        // pass->setMaterialScheme(scheme_ndr_name);
+                    }
+                }
+            }
+            // min depth pyramid, each level reduced from the one above
+            for (size_t level = 1; level <= ssr_compositor::hiz_levels; ++level) {
+                Ogre::CompositionTargetPass &pass_hiz = *pipeline->createTargetPass();
+                pass_hiz.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_hiz.setOutputName(ssr_compositor_hiz_name(level));
+                ssr_compositor_profile_begin(self, pass_hiz, ssr_compositor_hiz_name(level)); {
+                    Ogre::CompositionPass *pass = pass_hiz.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    if (level == 1 && self.ndr_single_pass) {
+                        pass->setMaterialName(material_hiz_from_ndr_name);
+                        pass->setInput(0, rt_gbuffer_name, ssr_compositor::gbuffer_ndr);
+                    } else if (level == 1 && self.ndr_packed) {
+                        pass->setMaterialName(material_hiz_name);
+                        pass->setInput(0, rt_out_ndr_name, ssr_compositor::ndr_packed_depth);
+                    } else if (level == 1) {
+                        pass->setMaterialName(material_hiz_from_ndr_name);
+                        pass->setInput(0, rt_out_ndr_name);
+                    } else {
+                        pass->setMaterialName(material_hiz_name);
+                        pass->setInput(0, ssr_compositor_hiz_name(level - 1));
+                    }
+                }
+            }
+            // scene colour pyramid, each level blurred down from the one above
+            if (ssr_compositor_glossy(self, desc)) {
+                for (size_t level = 1; level <= ssr_compositor::scene_blur_levels; ++level) {
+                    Ogre::CompositionTargetPass &pass_scene_blur = *pipeline->createTargetPass();
+                    pass_scene_blur.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                    pass_scene_blur.setOutputName(ssr_compositor_scene_blur_name(level));
+                    ssr_compositor_profile_begin(self, pass_scene_blur, ssr_compositor_scene_blur_name(level)); {
+                        Ogre::CompositionPass *pass = pass_scene_blur.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                        pass->setMaterialName(material_scene_blur_name);
+                        if (level == 1) {
+                            ssr_compositor_set_scene_input(self, *pass, 0);
+                        } else {
+                            pass->setInput(0, ssr_compositor_scene_blur_name(level - 1));
+                        }
+                    }
+                }
+            }
+            // one texel per tile telling the raytrace whether to skip, coarsely trace or fully trace it
+            if (self.tile_classify) {
+                Ogre::CompositionTargetPass &pass_tiles = *pipeline->createTargetPass();
+                pass_tiles.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_tiles.setOutputName(rt_tiles_name);
+                ssr_compositor_profile_begin(self, pass_tiles, "tiles"); {
+                    Ogre::CompositionPass *pass = pass_tiles.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    pass->setMaterial(ssr_compositor_material_permutation(
+                        material_tiles_name,
+                        ssr_compositor_defines({
+                            ndr_define,
+                            "SSR_TILE_SIZE=" + std::to_string(ssr_compositor::tile_size),
+                        })
+                    ));
+                    pass->setIdentifier(ssr_logic::pass_id_tiles);
+                    ssr_logic::attach_constants(*pass->getMaterial()->getTechnique(0)->getPass(0)->getFragmentProgramParameters());
+                    ssr_compositor_set_ndr_inputs(self, *pass, 0, 1);
                 }
             }
             // raytrace reading from normal_depth_rough and scene colour
+            // separate reflections are composited by the upsample, the others by the trace itself
             {
-                Ogre::CompositionTargetPass &pass_raytrace = *pipeline->createTargetPass();
+                Ogre::CompositionTargetPass &pass_raytrace = reflection_separate
+                    ? *pipeline->createTargetPass()
+                    : *pipeline->getOutputTargetPass();
+                const std::string &raytrace_output_name = desc.ray_reuse ? rt_ray_hit_name : rt_reflection_name;
+                if (reflection_separate) {
+                    pass_raytrace.setOutputName(raytrace_output_name);
+                }
                 pass_raytrace.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
-                pass_raytrace.setOutputName(rt_in_out_temp_name); {
-                    Ogre::CompositionPass *pass = pass_raytrace.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
-                    pass->setMaterialName(material_raytrace_name);
-                    pass->setInput(0, rt_in_scene_name);
-                    pass->setInput(1, rt_out_ndr_name);
-
-                    // auto fparams = pass->getMaterial()->getTechnique(0)->getPass(0)->getFragmentProgramParameters();
-                    // const auto &projection_matrix = viewport.getCamera()->getProjectionMatrix();
-                    // fparams->setNamedConstant(
-                    //     "raytrace_projection_matrix",
-                    //     projection_matrix
-                    // );
-                    // fparams->setNamedConstant(
-                    //     "raytrace_i_projection_matrix",
-                    //     projection_matrix.inverse()
-                    // );
-                    // fparams->setNamedConstant(
-                    //     "raytrace_i_view_matrix",
-                    //     viewport.getCamera()->getViewMatrix().inverse()
-                    // );
+                ssr_compositor_profile_begin(self, pass_raytrace, "raytrace"); {
+                    Ogre::CompositionPass *pass = nullptr;
+                    if (ssr_compositor_raytrace_compute(self, desc)) {
+                        // a fixed number of workgroups walks over every tile of the target
+                        pass = pass_raytrace.createPass(Ogre::CompositionPass::PT_COMPUTE);
+                        pass->setThreads(Ogre::Vector3i(int(self.raytrace_compute_groups), 1, 1));
+                        pass->setInput(ssr_compositor_raytrace_output_unit, raytrace_output_name);
+                    } else {
+                        pass = pass_raytrace.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    }
+                    pass->setMaterial(ssr_compositor_raytrace_material(self, desc, self.quality));
+                    pass->setIdentifier(ssr_logic::pass_id_raytrace);
+                    ssr_compositor_set_scene_input(self, *pass, 0);
+                    ssr_compositor_set_ndr_inputs(self, *pass, 1, ssr_compositor_raytrace_planes_unit);
+                    for (size_t level = 1; level <= ssr_compositor::hiz_levels; ++level) {
+                        pass->setInput(1 + level, ssr_compositor_hiz_name(level));
+                    }
+                    if (self.tile_classify) {
+                        pass->setInput(ssr_compositor_raytrace_tiles_unit, rt_tiles_name);
+                    }
+                    if (ssr_compositor_glossy(self, desc)) {
+                        for (size_t level = 1; level <= ssr_compositor::scene_blur_levels; ++level) {
+                            pass->setInput(ssr_compositor_raytrace_scene_blur_unit + level - 1, ssr_compositor_scene_blur_name(level));
+                        }
+                    }
+                    ssr_compositor_scissor_reset(self, desc, pass_raytrace);
                 }
             }
-            // copyback
-            {
-                Ogre::CompositionTargetPass &pass_blit = *pipeline->getOutputTargetPass();
-                pass_blit.setInputMode(Ogre::CompositionTargetPass::IM_NONE); {
-                    Ogre::CompositionPass *pass = pass_blit.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+            // shade every pixel from the rays traced around it
+            if (desc.ray_reuse) {
+                Ogre::CompositionTargetPass &pass_resolve = *pipeline->createTargetPass();
+                pass_resolve.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_resolve.setOutputName(rt_reflection_name);
+                ssr_compositor_profile_begin(self, pass_resolve, "resolve"); {
+                    Ogre::CompositionPass *pass = pass_resolve.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    pass->setMaterial(ssr_compositor_material_permutation(material_resolve_name, reflection_defines));
+                    pass->setIdentifier(ssr_logic::pass_id_resolve);
+                    ssr_logic::attach_constants(*pass->getMaterial()->getTechnique(0)->getPass(0)->getFragmentProgramParameters());
+                    ssr_compositor_set_scene_input(self, *pass, 0);
+                    ssr_compositor_set_ndr_inputs(self, *pass, 1, 3);
+                    pass->setInput(2, rt_ray_hit_name);
+                    ssr_compositor_scissor_reset(self, desc, pass_resolve);
+                }
+            }
+            // bilateral blur of the reflection along x into the denoise target and along y back
+            if (self.denoise) {
+                const std::array<std::pair<const std::string *, const std::string *>, 2> axes{{
+                    {&rt_reflection_name, &rt_reflection_denoise_name},
+                    {&rt_reflection_denoise_name, &rt_reflection_name},
+                }};
+                for (size_t axis = 0; axis < axes.size(); ++axis) {
+                    Ogre::CompositionTargetPass &pass_denoise = *pipeline->createTargetPass();
+                    pass_denoise.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                    pass_denoise.setOutputName(*axes[axis].second);
+                    ssr_compositor_profile_begin(self, pass_denoise, axis == 0 ? "denoise_x" : "denoise_y"); {
+                        Ogre::CompositionPass *pass = pass_denoise.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                        pass->setMaterial(ssr_compositor_material_permutation(
+                            material_denoise_name,
+                            ssr_compositor_defines({reflection_defines, axis == 0 ? "" : "SSR_DENOISE_VERTICAL"})
+                        ));
+                        pass->setIdentifier(ssr_logic::pass_id_denoise);
+                        ssr_logic::attach_constants(*pass->getMaterial()->getTechnique(0)->getPass(0)->getFragmentProgramParameters());
+                        pass->setInput(0, *axes[axis].first);
+                        ssr_compositor_set_ndr_inputs(self, *pass, 1, 2);
+                        ssr_compositor_scissor_reset(self, desc, pass_denoise);
+                    }
+                }
+            }
+            // reproject and accumulate the reflection over the previous frames, then keep it as history
+            if (desc.temporal) {
+                Ogre::CompositionTargetPass &pass_temporal = *pipeline->createTargetPass();
+                pass_temporal.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_temporal.setOutputName(rt_reflection_resolved_name);
+                ssr_compositor_profile_begin(self, pass_temporal, "temporal"); {
+                    Ogre::CompositionPass *pass = pass_temporal.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    pass->setMaterial(ssr_compositor_material_permutation(material_temporal_name, reflection_defines));
+                    pass->setIdentifier(ssr_logic::pass_id_temporal);
+                    ssr_logic::attach_constants(*pass->getMaterial()->getTechnique(0)->getPass(0)->getFragmentProgramParameters());
+                    pass->setInput(0, rt_reflection_name);
+                    pass->setInput(1, rt_history_name);
+                    ssr_compositor_set_ndr_inputs(self, *pass, 2, 3);
+                    ssr_compositor_scissor_reset(self, desc, pass_temporal);
+                }
+
+                Ogre::CompositionTargetPass &pass_history = *pipeline->createTargetPass();
+                pass_history.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                pass_history.setOutputName(rt_history_name);
+                ssr_compositor_profile_begin(self, pass_history, "history"); {
+                    Ogre::CompositionPass *pass = pass_history.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
                     pass->setMaterialName(material_copyback_name);
-                    pass->setInput(0, rt_in_out_temp_name);
+                    pass->setInput(0, rt_reflection_resolved_name);
+                }
+            }
+            if (reflection_separate) {
+                // depth and normal aware upsample of the reflection over the scene colour
+                Ogre::CompositionTargetPass &pass_upsample = *pipeline->getOutputTargetPass();
+                pass_upsample.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+                ssr_compositor_profile_begin(self, pass_upsample, "upsample"); {
+                    Ogre::CompositionPass *pass = pass_upsample.createPass(Ogre::CompositionPass::PT_RENDERQUAD);
+                    pass->setMaterial(ssr_compositor_material_permutation(material_upsample_name, reflection_defines));
+                    ssr_logic::attach_constants(*pass->getMaterial()->getTechnique(0)->getPass(0)->getFragmentProgramParameters());
+                    ssr_compositor_set_scene_input(self, *pass, 0);
+                    ssr_compositor_set_ndr_inputs(self, *pass, 1, 3);
+                    pass->setInput(2, desc.temporal ? rt_reflection_resolved_name : rt_reflection_name);
                 }
             }
+            ssr_compositor_profile_end(*pipeline);
+            ssr_compositor_set_hiz_enabled(*pipeline, self.quality.hiz_traversal_enable);
+        }
+    }
+    return compositor;
+}
+
+// every render_quad and render_scene covers the whole target it writes
+static size_t ssr_compositor_fullscreen_passes(const Ogre::CompositionTechnique &technique) {
+    size_t count = 0;
+    auto count_target_pass = [&count](const Ogre::CompositionTargetPass &target_pass) {
+        if (target_pass.getOnlyInitial()) {
+            return;
         }
+        for (const Ogre::CompositionPass *pass : target_pass.getPasses()) {
+            const auto type = pass->getType();
+            count += type == Ogre::CompositionPass::PT_RENDERQUAD || type == Ogre::CompositionPass::PT_RENDERSCENE;
+        }
+    };
+    for (const Ogre::CompositionTargetPass *target_pass : technique.getTargetPasses()) {
+        count_target_pass(*target_pass);
+    }
+    count_target_pass(*technique.getOutputTargetPass());
+    return count;
+}
+
+static auto ssr_compositor_create_pipelines(const ssr_compositor &self, Ogre::CompositorManager &composer) {
+    std::array<Ogre::CompositorPtr, ssr_compositor::pipelines_count> compositors{};
+    for (size_t i = 0; i < ssr_compositor::pipelines_count; ++i) {
+        compositors[i] = ssr_compositor_create_pipeline(self, ssr_compositor::pipeline_descs[i], composer);
     }
-    return std::array{compositor};
+    return compositors;
 }
 
 template<size_t N>
@@ -171,12 +779,304 @@ static auto ssr_compositor_register_pipelines(
     return instances;
 }
 
-void ssr_compositor::enable_pipelines(Ogre::Viewport &viewport, Ogre::CompositorManager &composer) {
+// reads the raytrace inputs of instance back, ssr/constants holds its camera once its raytrace quad is up
+static bool ssr_compositor_capture(const ssr_compositor &self, Ogre::CompositorInstance &instance, const std::string &path) {
+    const std::string &compositor_name = instance.getCompositor()->getName();
+    auto texture = [&](const std::string &logical_name, size_t plane) {
+        return instance.getTextureInstance(self.rt_pool.physical_name(compositor_name, logical_name), plane);
+    };
+    struct readback {
+        ssr_capture::plane_kind kind;
+        ssr_capture::plane_format format;
+        Ogre::PixelFormat pixel_format;
+        Ogre::TexturePtr texture;
+    };
+    std::vector<readback> readbacks{};
+    if (self.ndr_single_pass) {
+        readbacks.push_back({
+            ssr_capture::plane_kind::scene_colour, ssr_capture::plane_format::rgba8, Ogre::PF_BYTE_RGBA,
+            texture(rt_gbuffer_name, ssr_compositor::gbuffer_scene),
+        });
+        readbacks.push_back({
+            ssr_capture::plane_kind::ndr, ssr_capture::plane_format::rgba32f, Ogre::PF_FLOAT32_RGBA,
+            texture(rt_gbuffer_name, ssr_compositor::gbuffer_ndr),
+        });
+    } else {
+        readbacks.push_back({
+            ssr_capture::plane_kind::scene_colour, ssr_capture::plane_format::rgba8, Ogre::PF_BYTE_RGBA,
+            texture(rt_in_scene_name, 0),
+        });
+        if (self.ndr_packed) {
+            readbacks.push_back({
+                ssr_capture::plane_kind::ndr_normal_octahedral, ssr_capture::plane_format::rg16, Ogre::PF_SHORT_GR,
+                texture(rt_out_ndr_name, ssr_compositor::ndr_packed_normal),
+            });
+            readbacks.push_back({
+                ssr_capture::plane_kind::ndr_depth, ssr_capture::plane_format::r32f, Ogre::PF_FLOAT32_R,
+                texture(rt_out_ndr_name, ssr_compositor::ndr_packed_depth),
+            });
+            readbacks.push_back({
+                ssr_capture::plane_kind::ndr_roughness, ssr_capture::plane_format::r8, Ogre::PF_R8,
+                texture(rt_out_ndr_name, ssr_compositor::ndr_packed_roughness),
+            });
+        } else {
+            readbacks.push_back({
+                ssr_capture::plane_kind::ndr, ssr_capture::plane_format::rgba32f, Ogre::PF_FLOAT32_RGBA,
+                texture(rt_out_ndr_name, 0),
+            });
+        }
+    }
+    for (const auto &plane : readbacks) {
+        if (!plane.texture) {
+            return false;
+        }
+    }
+
+    ssr_capture::header header{};
+    header.width = readbacks.front().texture->getWidth();
+    header.height = readbacks.front().texture->getHeight();
+
+    const Ogre::GpuSharedParametersPtr constants =
+        Ogre::GpuProgramManager::getSingleton().getSharedParameters(ssr_logic::constants_name);
+    const std::array<std::pair<const char *, std::array<float, 16> *>, 3> matrices{{
+        {"raytrace_projection_matrix", &header.projection_matrix},
+        {"raytrace_i_projection_matrix", &header.i_projection_matrix},
+        {"raytrace_i_view_matrix", &header.i_view_matrix},
+    }};
+    for (const auto &[name, matrix] : matrices) {
+        std::memcpy(matrix->data(), constants->getFloatPointer(constants->getConstantDefinition(name).physicalIndex), sizeof(*matrix));
+    }
+    std::memcpy(
+        &header.raytrace_frame,
+        constants->getIntPointer(constants->getConstantDefinition("raytrace_frame").physicalIndex),
+        sizeof(header.raytrace_frame)
+    );
+    const Ogre::Camera &camera = *instance.getChain()->getViewport()->getCamera();
+    header.near_clip_plane = camera.getNearClipDistance();
+    header.far_clip_plane = camera.getFarClipDistance();
+    header.raytrace = {
+        self.quality.steps_max,
+        self.quality.steps_bsearch_max,
+        self.quality.distance_max_vs,
+        self.quality.thickness_radius_vs,
+        self.quality.frustum_clip_enable,
+        self.quality.bsearch_enable,
+    };
+
+    std::vector<std::vector<uint8_t>> storage{};
+    std::vector<ssr_capture::plane_data> planes{};
+    for (const auto &plane : readbacks) {
+        storage.emplace_back(size_t(header.width) * header.height * ssr_capture::bytes_per_pixel(plane.format));
+        plane.texture->getBuffer()->blitToMemory(
+            Ogre::PixelBox(header.width, header.height, 1, plane.pixel_format, storage.back().data())
+        );
+        planes.push_back({plane.kind, plane.format, storage.back().data()});
+    }
+    return ssr_capture::write(path, header, planes);
+}
+
+struct ssr_compositor_capture_listener : public Ogre::CompositorInstance::Listener {
+    ssr_compositor &self;
+    Ogre::CompositorInstance &instance;
+
+    ssr_compositor_capture_listener(ssr_compositor &self, Ogre::CompositorInstance &instance) :
+        self{self},
+        instance{instance} { }
+
+    // the scene, normal_depth_rough and hi-z passes are done by the time the raytrace quad renders
+    void notifyMaterialRender(Ogre::uint32 pass_id, Ogre::MaterialPtr &mat) override {
+        (void)mat;
+        if (pass_id != ssr_logic::pass_id_raytrace || self.capture_path.empty()) {
+            return;
+        }
+        const bool written = ssr_compositor_capture(self, instance, self.capture_path);
+        Ogre::LogManager::getSingleton().logMessage(
+            instance.getCompositor()->getName() + ": " + (written ? "captured " : "failed to capture ") + self.capture_path
+        );
+        self.capture_path.clear();
+    }
+};
+
+void ssr_compositor::enable_pipelines(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, size_t pipeline_index) {
+    // pipelines are alternatives, only the selected one runs
+    for (size_t i = 0; i < pipelines_count; ++i) {
+        const auto &name = pipelines[i]->getName();
+        composer.setCompositorEnabled(&viewport, name, i == pipeline_index);
+    }
+    Ogre::LogManager::getSingleton().logMessage(
+        pipelines[pipeline_index]->getName() + ": " + std::to_string(vram_bytes()) + " bytes of render targets"
+    );
+}
+void ssr_compositor::set_quality(Ogre::CompositorManager &composer, const quality_desc &quality) {
+    this->quality = quality;
+    for (size_t i = 0; i < pipelines_count; ++i) {
+        Ogre::CompositionPass *pass = ssr_compositor_find_pass(*pipelines[i]->getTechnique(0), ssr_logic::pass_id_raytrace);
+        pass->setMaterial(ssr_compositor_raytrace_material(*this, pipeline_descs[i], quality));
+        ssr_compositor_set_hiz_enabled(*pipelines[i]->getTechnique(0), quality.hiz_traversal_enable);
+    }
+    // compiled render quads hold on to the material they were compiled with
+    for (const viewport_instances &instances : viewports) {
+        composer.getCompositorChain(instances.viewport)->_markDirty();
+    }
+}
+size_t ssr_compositor::vram_bytes() const {
+    std::vector<Ogre::CompositorInstance *> instances{};
+    for (const viewport_instances &viewport : viewports) {
+        instances.insert(instances.end(), viewport.pipeline_instances.begin(), viewport.pipeline_instances.end());
+    }
+    return ssr_rt_pool::vram_bytes(instances);
+}
+// governor level between the quality bounds, 0 the lowest
+static ssr_compositor::quality_desc ssr_compositor_governor_quality(const ssr_compositor &self, size_t level) {
+    const float t = float(level) / float(ssr_governor::levels_count - 1);
+    auto steps = [t](unsigned min, unsigned max) {
+        return unsigned(std::lround(float(min) + (float(max) - float(min)) * t));
+    };
+    const ssr_compositor::quality_desc &min = self.governor_quality_min;
+    ssr_compositor::quality_desc quality = self.governor_quality_max;
+    quality.steps_max = steps(min.steps_max, quality.steps_max);
+    quality.steps_bsearch_max = steps(min.steps_bsearch_max, quality.steps_bsearch_max);
+    quality.steps_hiz_max = steps(min.steps_hiz_max, quality.steps_hiz_max);
+    quality.distance_max_vs = min.distance_max_vs + (quality.distance_max_vs - min.distance_max_vs) * t;
+    quality.bsearch_enable = quality.bsearch_enable && quality.steps_bsearch_max != 0;
+    return quality;
+}
+
+// a level step swaps the raytrace permutations in mid frame, the permutations of every level are
+// compiled up front rather than in the frame first stepping to them
+static void ssr_compositor_governor_compile(const ssr_compositor &self) {
+    for (size_t level = 0; level < ssr_governor::levels_count; ++level) {
+        const ssr_compositor::quality_desc quality = ssr_compositor_governor_quality(self, level);
+        for (const ssr_compositor::pipeline_desc &desc : ssr_compositor::pipeline_descs) {
+            ssr_compositor_raytrace_material(self, desc, quality);
+        }
+    }
+}
+
+void ssr_compositor::set_governor_enabled(bool enabled) {
+    if (enabled && !governor.enabled) {
+        ssr_compositor_governor_compile(*this);
+    }
+    governor.enabled = enabled;
+}
+void ssr_compositor::update_governor(Ogre::CompositorManager &composer) {
+    // the raytrace of every viewport counts against the one budget
+    // the viewports running a pipeline share its stage, whose samples lag the frames by a varying count
+    // and may be dropped, so a frame costs the mean of the new samples once per viewport running it
+    float raytrace_ms = 0.0f;
+    bool measured = false;
+    for (size_t i = 0; i < pipelines_count; ++i) {
+        const size_t instances = std::count_if(viewports.begin(), viewports.end(), [i](const viewport_instances &viewport) {
+            return viewport.pipeline_instances[i]->getEnabled();
+        });
+        const std::string name = pipelines[i]->getName() + "/raytrace";
+        auto it = std::find_if(profiler.stages.begin(), profiler.stages.end(), [&name](const auto &stage) {
+            return stage->name == name;
+        });
+        if (it == profiler.stages.end()) {
+            continue;
+        }
+        const ssr_profiler::stage &stage = **it;
+        size_t &seen = governor_samples[&stage];
+        // profiler.reset_samples() started the count over
+        if (seen > stage.gpu_samples) {
+            seen = 0;
+        }
+        // the window only keeps the last window_size samples
+        seen = std::max(seen, stage.gpu_samples - std::min(stage.gpu_samples, ssr_profiler::window_size));
+        if (seen == stage.gpu_samples || instances == 0) {
+            seen = stage.gpu_samples;
+            continue;
+        }
+        float sum_ms = 0.0f;
+        const size_t count = stage.gpu_samples - seen;
+        for (; seen < stage.gpu_samples; ++seen) {
+            sum_ms += stage.gpu_ms[seen % ssr_profiler::window_size];
+        }
+        raytrace_ms += sum_ms / float(count) * float(instances);
+        measured = true;
+    }
+    if (!measured) {
+        return;
+    }
+
+    bool render_scale_enabled = false;
+    for (const viewport_instances &viewport : viewports) {
+        for (size_t i = 0; i < pipelines_count; ++i) {
+            render_scale_enabled |= viewport.pipeline_instances[i]->getEnabled()
+                && ssr_compositor_dynamic_resolution(*this, pipeline_descs[i]);
+        }
+    }
+    const size_t level = governor.level;
+    if (!governor.update(raytrace_ms, render_scale_enabled)) {
+        return;
+    }
+    if (governor.level != level) {
+        set_quality(composer, ssr_compositor_governor_quality(*this, governor.level));
+    }
+    for (const viewport_instances &viewport : viewports) {
+        set_render_scale(*viewport.viewport, governor.render_scale);
+    }
+    const ssr_governor::status status = governor.report();
+    Ogre::LogManager::getSingleton().logMessage(
+        "ssr governor: " + std::to_string(status.measured_ms) + " of " + std::to_string(status.budget_ms) + " ms" +
+        ", level " + std::to_string(status.level) +
+        ", render scale " + std::to_string(status.render_scale) +
+        ", " + std::to_string(quality.steps_max) + " steps" +
+        ", " + std::to_string(quality.steps_bsearch_max) + " bsearch steps" +
+        ", " + std::to_string(quality.steps_hiz_max) + " hi-z steps" +
+        ", " + std::to_string(quality.distance_max_vs) + " distance"
+    );
+}
+void ssr_compositor::set_ndr_filter(
+    Ogre::CompositorManager &composer,
+    Ogre::uint8 first_render_queue,
+    Ogre::uint8 last_render_queue,
+    Ogre::uint32 visibility_mask
+) {
+    ndr_first_render_queue = first_render_queue;
+    ndr_last_render_queue = last_render_queue;
+    ndr_visibility_mask = visibility_mask;
     for (const auto &pipeline : pipelines) {
-        const auto &name = pipeline->getName();
-        composer.setCompositorEnabled(&viewport, name, true);
+        for (Ogre::CompositionTargetPass *target_pass : pipeline->getTechnique(0)->getTargetPasses()) {
+            if (target_pass->getMaterialScheme() != scheme_ndr_name) {
+                continue;
+            }
+            target_pass->setVisibilityMask(visibility_mask);
+            for (Ogre::CompositionPass *pass : target_pass->getPasses()) {
+                if (pass->getType() == Ogre::CompositionPass::PT_RENDERSCENE) {
+                    pass->setFirstRenderQueue(first_render_queue);
+                    pass->setLastRenderQueue(last_render_queue);
+                }
+            }
+        }
+    }
+    // the target operations copied the filter when the chains compiled
+    for (const viewport_instances &instances : viewports) {
+        composer.getCompositorChain(instances.viewport)->_markDirty();
     }
 }
+void ssr_compositor::set_ndr_visible(Ogre::MovableObject &object, bool visible) const {
+    const Ogre::uint32 flags = object.getVisibilityFlags();
+    object.setVisibilityFlags(visible ? flags | ndr_visibility_mask : flags & ~ndr_visibility_mask);
+}
+void ssr_compositor::set_render_scale(Ogre::Viewport &viewport, float scale) {
+    ssr.render_scales[&viewport] = std::clamp(scale, render_scale_min, 1.0f);
+}
+void ssr_compositor::capture(const std::string &path) {
+    capture_path = path;
+}
+Ogre::MaterialPtr ssr_compositor::reference_raytrace_material(const quality_desc &quality) {
+    quality_desc reference = quality;
+    reference.hiz_traversal_enable = false;
+    reference.dda_enable = false;
+    Ogre::MaterialPtr material = ssr_compositor_material_permutation(
+        material_raytrace_name,
+        ssr_compositor_quality_defines(reference)
+    );
+    ssr_logic::attach_constants(ssr_compositor_program_parameters(*material));
+    return material;
+}
 void ssr_compositor::disable_pipelines(Ogre::Viewport &viewport, Ogre::CompositorManager &composer) {
     for (const auto &pipeline : pipelines) {
         const auto &name = pipeline->getName();
@@ -184,6 +1084,146 @@ void ssr_compositor::disable_pipelines(Ogre::Viewport &viewport, Ogre::Composito
     }
 }
 
+// material and defines of the normal_depth_rough pass for a vertex layout, hardware skinned and instanced ones differ
+struct ssr_compositor_ndr_layout {
+    const std::string *material_name;
+    std::string defines;
+};
+static ssr_compositor_ndr_layout ssr_compositor_ndr_pass_layout(const ssr_compositor &self, const Ogre::Renderable *rend) {
+    const std::string_view ndr_define = self.ndr_packed ? "SSR_NDR_PACKED" : "";
+    if (const auto *sub_entity = dynamic_cast<const Ogre::SubEntity *>(rend)) {
+        Ogre::Entity &entity = *sub_entity->getParent();
+        if (entity.hasSkeleton() && entity.isHardwareAnimationEnabled()) {
+            const Ogre::SubMesh &sub_mesh = *sub_entity->getSubMesh();
+            const Ogre::VertexData &vertex_data = sub_mesh.useSharedVertices
+                ? *entity.getMesh()->sharedVertexData
+                : *sub_mesh.vertexData;
+            const Ogre::VertexElement *weights = vertex_data.vertexDeclaration->findElementBySemantic(Ogre::VES_BLEND_WEIGHTS);
+            if (weights != nullptr) {
+                return {&material_ndr_skinning_name, ssr_compositor_defines({
+                    ndr_define,
+                    "SSR_NDR_BLEND_WEIGHTS=" + std::to_string(Ogre::VertexElement::getTypeCount(weights->getType())),
+                })};
+            }
+        }
+    }
+    if (const auto *batch = dynamic_cast<const Ogre::InstanceBatchHW *>(rend)) {
+        // the batch only hands its vertex layout out through a non const render operation
+        Ogre::RenderOperation operation{};
+        const_cast<Ogre::InstanceBatchHW *>(batch)->getRenderOperation(operation);
+        // the world matrices follow the texture coordinates of the mesh in the per instance buffer
+        unsigned short instance_uv = USHRT_MAX;
+        for (const Ogre::VertexElement &element : operation.vertexData->vertexDeclaration->getElements()) {
+            const bool instance_data = element.getSemantic() == Ogre::VES_TEXTURE_COORDINATES
+                && operation.vertexData->vertexBufferBinding->getBuffer(element.getSource())->isInstanceData();
+            if (instance_data) {
+                instance_uv = std::min(instance_uv, element.getIndex());
+            }
+        }
+        if (instance_uv != USHRT_MAX) {
+            return {&material_ndr_instancing_name, ssr_compositor_defines({
+                ndr_define,
+                "SSR_NDR_INSTANCING_UV=" + std::to_string(instance_uv),
+            })};
+        }
+    }
+    return {&material_ndr_name, std::string(ndr_define)};
+}
+
+// skinned and instanced materials wait for a renderable to pick the vertex program of their pass
+static bool ssr_compositor_ndr_per_renderable(Ogre::Material &material) {
+    Ogre::Technique *technique = material.getBestTechnique();
+    if (technique == nullptr) {
+        return false;
+    }
+    for (const Ogre::Pass *pass : technique->getPasses()) {
+        if (pass->hasVertexProgram()) {
+            const Ogre::GpuProgramPtr &program = pass->getVertexProgram();
+            if (program->isSkeletalAnimationIncluded() || program->isInstancingIncluded()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// the normal_depth_rough pass of layout with the lighting of material
+static void ssr_compositor_ndr_create_pass(Ogre::Technique &technique, Ogre::Material &material, const ssr_compositor_ndr_layout &layout) {
+    const Ogre::MaterialPtr ndr_material = ssr_compositor_material_permutation(*layout.material_name, layout.defines);
+    technique.setSchemeName(scheme_ndr_name);
+    Ogre::Pass *pass = technique.createPass();
+    *pass = *ndr_material->getTechnique(0)->getPass(0);
+
+    pass->setSpecular(material.getTechnique(0)->getPass(0)->getSpecular());
+    pass->setShininess(material.getTechnique(0)->getPass(0)->getShininess());
+}
+
+// the normal_depth_rough technique of material, per vertex layout for skinned and instanced ones
+static Ogre::Technique *ssr_compositor_ndr_technique(ssr_compositor &self, Ogre::Material &material, const Ogre::Renderable *rend) {
+    if (auto it = self.ndr_renderable_techniques.find(rend); it != self.ndr_renderable_techniques.end()) {
+        if (it->second.material == material.getHandle()) {
+            return it->second.technique;
+        }
+    }
+    if (auto it = self.ndr_techniques.find(material.getHandle()); it != self.ndr_techniques.end()) {
+        // a reloaded material rebuilt its techniques, the cached one only holds while it is still listed
+        const auto &techniques = material.getTechniques();
+        if (std::find(techniques.begin(), techniques.end(), it->second) != techniques.end()) {
+            return it->second;
+        }
+        self.ndr_techniques.erase(it);
+    }
+    const bool per_renderable = rend != nullptr && ssr_compositor_ndr_per_renderable(material);
+    // renderables of one material may differ in layout, their techniques live in clones named after both
+    std::string layout_material_name{};
+    const ssr_compositor_ndr_layout layout = ssr_compositor_ndr_pass_layout(self, rend);
+    if (per_renderable) {
+        layout_material_name = layout.defines + "/" + *layout.material_name + "/" + material.getName();
+        if (auto it = self.ndr_layout_techniques.find(layout_material_name); it != self.ndr_layout_techniques.end()) {
+            self.ndr_renderable_techniques[rend] = {material.getHandle(), it->second};
+            return it->second;
+        }
+    }
+
+    // source: https://forums.ogre3d.org/viewtopic.php?p=551751#p551751
+    Ogre::Technique *technique = nullptr;
+    Ogre::RTShader::ShaderGenerator::getSingleton().validateMaterial(scheme_ndr_name, material);
+    for (Ogre::Technique *candidate : material.getTechniques()) {
+        if (candidate->getSchemeName() == scheme_ndr_name) {
+            technique = candidate;
+            break;
+        }
+    }
+    if (technique == nullptr && per_renderable) {
+        Ogre::MaterialPtr layout_material = Ogre::MaterialManager::getSingleton().create(layout_material_name, material.getGroup());
+        layout_material->removeAllTechniques();
+        technique = layout_material->createTechnique();
+        ssr_compositor_ndr_create_pass(*technique, material, layout);
+        layout_material->load();
+        self.ndr_layout_techniques[layout_material_name] = technique;
+        self.ndr_renderable_techniques[rend] = {material.getHandle(), technique};
+        return technique;
+    }
+    if (technique == nullptr) {
+        technique = material.createTechnique();
+        ssr_compositor_ndr_create_pass(*technique, material, layout);
+    }
+    self.ndr_techniques[material.getHandle()] = technique;
+    return technique;
+}
+
+static void ssr_compositor_prewarm_material(ssr_compositor &self, const Ogre::MaterialPtr &material) {
+    material->load();
+    if (ssr_compositor_ndr_per_renderable(*material)) {
+        material->compile();
+        return;
+    }
+    Ogre::Technique *technique = ssr_compositor_ndr_technique(self, *material, nullptr);
+    // compiles the programs now instead of in the frame that first draws the material
+    material->compile();
+    technique->_load();
+}
+
 Ogre::Technique *ssr_compositor::handleSchemeNotFound(
     unsigned short schemeIndex,
     const Ogre::String &schemeName,
@@ -192,72 +1232,146 @@ Ogre::Technique *ssr_compositor::handleSchemeNotFound(
     const Ogre::Renderable *rend
 ) {
     (void)schemeIndex;
+    (void)schemeName;
     (void)lodIndex;
-    (void)rend;
-    
-    // source: https://forums.ogre3d.org/viewtopic.php?p=551751#p551751
-    Ogre::ResourcePtr res = Ogre::MaterialManager::getSingleton().load(
-        material_ndr_name,
-        Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME
-    );
-    Ogre::MaterialPtr material = Ogre::static_pointer_cast<Ogre::Material>(res);
-
-    Ogre::RTShader::ShaderGenerator& rtShaderGen = Ogre::RTShader::ShaderGenerator::getSingleton();
-    for (unsigned short i=0; i< originalMaterial->getTechnique(0)->getNumPasses(); ++i) {
-        rtShaderGen.validateMaterial(scheme_ndr_name, *originalMaterial);
-        // Grab the generated technique.
-        for(Ogre::Technique* curTech : originalMaterial->getTechniques()) {
-            if (curTech->getSchemeName() == schemeName) {
-                return curTech;
+    return ssr_compositor_ndr_technique(*this, *originalMaterial, rend);
+}
+
+void ssr_compositor::prewarm(const std::vector<Ogre::MaterialPtr> &materials, bool deferred) {
+    if (!deferred) {
+        for (const auto &material : materials) {
+            ssr_compositor_prewarm_material(*this, material);
+        }
+        return;
+    }
+    // programs compile on the render thread, the work queue hands out its tasks there a few per frame
+    Ogre::WorkQueue &work_queue = *Ogre::Root::getSingleton().getWorkQueue();
+    for (const auto &material : materials) {
+        work_queue.addMainThreadTask([owner = std::weak_ptr<ssr_compositor *>(prewarm_owner), material] {
+            if (const auto self = owner.lock()) {
+                ssr_compositor_prewarm_material(**self, material);
             }
+        });
+    }
+}
+void ssr_compositor::prewarm(const std::string &resource_group, bool deferred) {
+    std::vector<Ogre::MaterialPtr> materials{};
+    for (const auto &[handle, resource] : Ogre::MaterialManager::getSingleton().getResources()) {
+        (void)handle;
+        if (resource->getGroup() == resource_group) {
+            materials.push_back(Ogre::static_pointer_cast<Ogre::Material>(resource));
         }
     }
-
-    Ogre::Technique &technique_ndr = *originalMaterial->createTechnique();
-    technique_ndr.setSchemeName(schemeName);
-    Ogre::Pass* pass = technique_ndr.createPass();
-    *pass = *material->getTechnique(0)->getPass(0);
-    
-    pass->setSpecular(originalMaterial->getTechnique(0)->getPass(0)->getSpecular());
-    pass->setShininess(originalMaterial->getTechnique(0)->getPass(0)->getShininess());
-
-    return &technique_ndr;
+    prewarm(materials, deferred);
 }
 
-void ssr_compositor::init(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager, Ogre::TextureManager &texture_manager) {
+void ssr_compositor::init(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager) {
     material_manager.addListener(this, scheme_ndr_name);
+    prewarm_owner = std::make_shared<ssr_compositor *>(this);
     composer.registerCompositorLogic(ssr.name, &ssr);
-    
-    const auto [ndr, scene, temp] = ssr_compositor_init_textures(
-        viewport,
-        texture_manager
-    );
-    normal_depth_rough = ndr;
-    this->scene = scene;
-    this->temp = temp;
+    composer.registerCustomCompositionPass(ssr_logic::scissor_reset_type, &ssr);
+
+    if (ndr_single_pass) {
+        // the generated shaders only get one extra colour output, not the three packed planes
+        ndr_packed = false;
+        ssr_ndr_render_state_attach(
+            Ogre::RTShader::ShaderGenerator::getSingleton(),
+            viewport.getMaterialScheme()
+        );
+    }
 
-    const auto [compositor] = ssr_compositor_create_pipelines(*this, viewport, composer);
-    pipelines[0] = compositor;
+    if (governor.enabled) {
+        profile = true;
+        governor.reset();
+        quality = ssr_compositor_governor_quality(*this, governor.level);
+    }
 
-    const auto [instance] = ssr_compositor_register_pipelines(pipelines, viewport, composer);
-    pipeline_instances[0] = instance;
-    ssr.compositorInstanceCreated(instance);
+    pipelines = ssr_compositor_create_pipelines(*this, composer);
+    for (size_t i = 0; i < pipelines_count; ++i) {
+        if (ssr_compositor_dynamic_resolution(*this, pipeline_descs[i])) {
+            ssr.render_scaled_compositors.insert(pipelines[i]->getName());
+        }
+    }
+    for (const auto &pipeline : pipelines) {
+        rt_pool.allocate(pipeline->getName(), *pipeline->getTechnique(0));
+        if (profile) {
+            profiler.attach(composer, *pipeline->getTechnique(0));
+        }
+        Ogre::LogManager::getSingleton().logMessage(
+            pipeline->getName() + ": " +
+            std::to_string(ssr_compositor_fullscreen_passes(*pipeline->getTechnique(0))) + " full screen passes per frame"
+        );
+    }
+    if (governor.enabled) {
+        ssr_compositor_governor_compile(*this);
+    }
+    add_viewport(viewport, composer);
+}
+void ssr_compositor::add_viewport(Ogre::Viewport &viewport, Ogre::CompositorManager &composer) {
+    viewport_instances &instances = viewports.emplace_back();
+    instances.viewport = &viewport;
+    instances.pipeline_instances = ssr_compositor_register_pipelines(pipelines, viewport, composer);
+    for (size_t i = 0; i < pipelines_count; ++i) {
+        // one ssr_instance per viewport and pipeline, each caching the camera of its own viewport
+        ssr.compositorInstanceCreated(instances.pipeline_instances[i]);
+        // after the logic listener, which writes the camera the capture reads
+        instances.capture_listeners[i] = std::make_unique<ssr_compositor_capture_listener>(*this, *instances.pipeline_instances[i]);
+        instances.pipeline_instances[i]->addListener(instances.capture_listeners[i].get());
+    }
 
     disable_pipelines(viewport, composer);
 }
-void ssr_compositor::deinit(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager, Ogre::TextureManager &texture_manager) {
-    material_manager.removeListener(this, scheme_ndr_name);
-    composer.unregisterCompositorLogic(ssr.name);
-    
-    for (const auto &instance : pipeline_instances) {
-        ssr.compositorInstanceDestroyed(instance);
+void ssr_compositor::remove_viewport(Ogre::Viewport &viewport, Ogre::CompositorManager &composer) {
+    auto it = std::find_if(viewports.begin(), viewports.end(), [&viewport](const viewport_instances &instances) {
+        return instances.viewport == &viewport;
+    });
+    if (it == viewports.end()) {
+        return;
+    }
+    for (size_t i = 0; i < pipelines_count; ++i) {
+        it->pipeline_instances[i]->removeListener(it->capture_listeners[i].get());
+        it->capture_listeners[i].reset();
+        ssr.compositorInstanceDestroyed(it->pipeline_instances[i]);
     }
     for (const auto &pipeline : pipelines) {
         const auto &name = pipeline->getName();
         composer.removeCompositor(&viewport, name);
     }
+    ssr.render_scales.erase(&viewport);
+    viewports.erase(it);
+}
+void ssr_compositor::deinit(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager) {
+    material_manager.removeListener(this, scheme_ndr_name);
+    composer.unregisterCompositorLogic(ssr.name);
+    composer.unregisterCustomCompositionPass(ssr_logic::scissor_reset_type);
 
-    texture_manager.remove(normal_depth_rough->getName(), texture_group_name);
-    texture_manager.remove(scene->getName(), texture_group_name);
-    texture_manager.remove(temp->getName(), texture_group_name);
+    if (ndr_single_pass) {
+        ssr_ndr_render_state_detach(
+            Ogre::RTShader::ShaderGenerator::getSingleton(),
+            viewport.getMaterialScheme()
+        );
+    }
+    
+    while (!viewports.empty()) {
+        remove_viewport(*viewports.back().viewport, composer);
+    }
+    // the next init creates them again under the same names, the permutations they use stay cached
+    for (Ogre::CompositorPtr &pipeline : pipelines) {
+        composer.remove(pipeline);
+        pipeline.reset();
+    }
+    ssr.render_scaled_compositors.clear();
+    capture_path.clear();
+    rt_pool.clear();
+    profiler.detach(composer);
+    governor_samples.clear();
+    // deferred pre-warms still queued find no owner and do nothing
+    prewarm_owner.reset();
+    ndr_techniques.clear();
+    for (const auto &[name, technique] : ndr_layout_techniques) {
+        (void)technique;
+        material_manager.remove(name, Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+    }
+    ndr_layout_techniques.clear();
+    ndr_renderable_techniques.clear();
 }
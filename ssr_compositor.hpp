@@ -3,17 +3,152 @@
 
 #include <OgreMaterialManager.h>
 #include <OgreCompositor.h>
+#include <OgrePixelFormat.h>
+#include <OgreRenderQueue.h>
 #include "ssr_logic.hpp"
+#include "ssr_rt_pool.hpp"
+#include "ssr_profiler.hpp"
+#include "ssr_governor.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 struct ssr_compositor : public Ogre::MaterialManager::Listener {
-    static constexpr size_t pipelines_count = 1;
+    struct pipeline_desc {
+        // appended to ssr_logic::name to name the compositor
+        std::string_view name;
+        // raytrace resolution relative to the viewport, upsampled below 1
+        float trace_scale;
+        // reproject and accumulate the reflection with a history target
+        bool temporal;
+        // trace one ray per trace_scale block and shade every pixel from the hits around it
+        bool ray_reuse;
+    };
+    static constexpr size_t pipelines_count = 6;
+    static constexpr size_t pipeline_full = 0;
+    static constexpr size_t pipeline_temporal = 1;
+    static constexpr size_t pipeline_half = 2;
+    static constexpr size_t pipeline_quarter = 3;
+    static constexpr size_t pipeline_stochastic = 4;
+    static constexpr size_t pipeline_stochastic_quarter = 5;
+    static constexpr std::array<pipeline_desc, pipelines_count> pipeline_descs{{
+        {"", 1.0f, false, false},
+        {"/temporal", 1.0f, true, false},
+        {"/half", 0.5f, true, false},
+        {"/quarter", 0.25f, true, false},
+        {"/stochastic", 0.5f, true, true},
+        {"/stochastic_quarter", 0.25f, true, true},
+    }};
+
+    // raytrace knobs, compiled into the raytrace shader as preprocessor defines
+    struct quality_desc {
+        unsigned steps_max;
+        unsigned steps_bsearch_max;
+        unsigned steps_hiz_max;
+        float distance_max_vs;
+        float thickness_radius_vs;
+        bool frustum_clip_enable;
+        bool bsearch_enable;
+        bool hiz_traversal_enable;
+        // march texel by texel in screen space when the hi-z traversal is off
+        bool dda_enable;
+    };
+    static constexpr size_t quality_presets_count = 4;
+    static constexpr size_t quality_low = 0;
+    static constexpr size_t quality_medium = 1;
+    static constexpr size_t quality_high = 2;
+    static constexpr size_t quality_ultra = 3;
+    static constexpr std::array<quality_desc, quality_presets_count> quality_presets{{
+        {24, 0, 24, 8.0f, 0.5f, true, false, true, true},
+        {48, 6, 32, 12.0f, 0.5f, true, true, true, true},
+        {64, 8, 48, 16.0f, 0.5f, true, true, true, true},
+        {128, 12, 96, 32.0f, 0.5f, true, true, true, true},
+    }};
+
+    // min depth pyramid levels, synchronized with HIZ_LEVELS in ssr_raytrace.glsl
+    static constexpr size_t hiz_levels = 6;
+    // blurred scene colour levels, synchronized with SCENE_BLUR_LEVELS in ssr_raytrace.glsl
+    static constexpr size_t scene_blur_levels = 5;
+    // packed normal_depth_rough planes: octahedral normal, ndc01 depth, roughness
+    static constexpr std::array<Ogre::PixelFormat, 3> ndr_packed_formats{
+        Ogre::PF_SHORT_GR,
+        Ogre::PF_FLOAT32_R,
+        Ogre::PF_R8,
+    };
+    static constexpr size_t ndr_packed_normal = 0;
+    static constexpr size_t ndr_packed_depth = 1;
+    static constexpr size_t ndr_packed_roughness = 2;
+
+    // pixels per side of a classified tile
+    static constexpr size_t tile_size = 8;
+
+    // single pass ssr_gbuffer planes
+    static constexpr size_t gbuffer_scene = 0;
+    static constexpr size_t gbuffer_ndr = 1;
+
     ssr_logic ssr{};
+    // read before init
+    bool ndr_packed = true;
+    // read before init, one scene pass writes scene colour and normal_depth_rough
+    bool ndr_single_pass = false;
+    // what the separate normal_depth_rough pass renders, see set_ndr_filter
+    Ogre::uint8 ndr_first_render_queue = Ogre::RENDER_QUEUE_1;
+    Ogre::uint8 ndr_last_render_queue = Ogre::RENDER_QUEUE_8 - 1;
+    // see set_ndr_visible
+    Ogre::uint32 ndr_visibility_mask = 1u << 31;
+    // read before init, skips the raytrace in tiles with no visible reflection
+    bool tile_classify = false;
+    // read before init, rough surfaces cone trace a blurred scene colour
+    bool glossy = false;
+    // read before init, bilateral blur of the reflection
+    bool denoise = false;
+    // read before init, traces separate reflections with a compute program
+    bool raytrace_compute = false;
+    unsigned raytrace_compute_groups = 256;
+    // read before init, separate reflections follow set_render_scale
+    bool dynamic_resolution = false;
+    static constexpr float render_scale_min = 0.25f;
+    // one of quality_presets or a custom set, changed at runtime through set_quality
+    quality_desc quality = quality_presets[quality_high];
     
-    Ogre::TexturePtr normal_depth_rough{};
-    Ogre::TexturePtr scene{};
-    Ogre::TexturePtr temp{};
+    ssr_rt_pool rt_pool{};
+    // read before init, times every target pass
+    bool profile = false;
+    ssr_profiler profiler{};
+    // holds the raytrace gpu time near a budget, turns profile on, see update_governor
+    ssr_governor governor{};
+    // quality of the lowest and highest governor levels
+    quality_desc governor_quality_min = quality_presets[quality_low];
+    quality_desc governor_quality_max = quality_presets[quality_ultra];
+    // profiler samples the governor has read, per stage
+    std::unordered_map<const ssr_profiler::stage *, size_t> governor_samples{};
+    // see capture
+    std::string capture_path{};
     std::array<Ogre::CompositorPtr, pipelines_count> pipelines{};
-    std::array<Ogre::CompositorInstance *, pipelines_count> pipeline_instances{};
+    // pipeline instances of one viewport
+    struct viewport_instances {
+        Ogre::Viewport *viewport;
+        std::array<Ogre::CompositorInstance *, pipelines_count> pipeline_instances;
+        std::array<std::unique_ptr<Ogre::CompositorInstance::Listener>, pipelines_count> capture_listeners;
+    };
+    // the init viewport first
+    std::vector<viewport_instances> viewports{};
+    // normal_depth_rough techniques by material handle
+    std::unordered_map<Ogre::ResourceHandle, Ogre::Technique *> ndr_techniques{};
+    // skinned and instanced variants, by clone name
+    std::unordered_map<std::string, Ogre::Technique *> ndr_layout_techniques{};
+    // the variant each renderable last drew with
+    struct ndr_renderable_technique {
+        Ogre::ResourceHandle material;
+        Ogre::Technique *technique;
+    };
+    std::unordered_map<const Ogre::Renderable *, ndr_renderable_technique> ndr_renderable_techniques{};
+    // deferred pre-warm tasks hold it weakly
+    std::shared_ptr<ssr_compositor *> prewarm_owner{};
 
     Ogre::Technique *handleSchemeNotFound(
         unsigned short schemeIndex, 
@@ -24,11 +159,39 @@ struct ssr_compositor : public Ogre::MaterialManager::Listener {
     ) override;
 
 
-    void init(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager, Ogre::TextureManager &texture_manager);
-    void deinit(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager, Ogre::TextureManager &texture_manager);
+    void init(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager);
+    void deinit(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, Ogre::MaterialManager &material_manager);
+    // after init, the viewport shares the material scheme of the init one with ndr_single_pass
+    void add_viewport(Ogre::Viewport &viewport, Ogre::CompositorManager &composer);
+    void remove_viewport(Ogre::Viewport &viewport, Ogre::CompositorManager &composer);
 
-    void enable_pipelines(Ogre::Viewport &viewport, Ogre::CompositorManager &composer);
+    void enable_pipelines(Ogre::Viewport &viewport, Ogre::CompositorManager &composer, size_t pipeline_index = pipeline_full);
     void disable_pipelines(Ogre::Viewport &viewport, Ogre::CompositorManager &composer);
+    // recompiles the raytrace of every pipeline for quality
+    void set_quality(Ogre::CompositorManager &composer, const quality_desc &quality);
+    void set_ndr_filter(
+        Ogre::CompositorManager &composer,
+        Ogre::uint8 first_render_queue,
+        Ogre::uint8 last_render_queue,
+        Ogre::uint32 visibility_mask
+    );
+    // keeps object out of normal_depth_rough through ndr_visibility_mask
+    void set_ndr_visible(Ogre::MovableObject &object, bool visible) const;
+    // fraction of the reflection targets viewport traces, needs dynamic_resolution
+    void set_render_scale(Ogre::Viewport &viewport, float scale);
+    // after init, compiles the raytrace of every governor level
+    void set_governor_enabled(bool enabled);
+    // once per frame after profiler.frame_ended, applies the governor level and render scale
+    void update_governor(Ogre::CompositorManager &composer);
+    // render target bytes of the enabled pipelines, shared textures counted once
+    size_t vram_bytes() const;
+    // builds normal_depth_rough techniques ahead of use, deferred spreads them over frames
+    void prewarm(const std::vector<Ogre::MaterialPtr> &materials, bool deferred = false);
+    void prewarm(const std::string &resource_group, bool deferred = false);
+    // writes the raytrace inputs of the next frame to path, see ssr_capture
+    void capture(const std::string &path);
+    // the raytrace ssr_cpu mirrors: scene colour at unit 0, unpacked normal_depth_rough at unit 1
+    static Ogre::MaterialPtr reference_raytrace_material(const quality_desc &quality);
 };
 
 #endif
\ No newline at end of file
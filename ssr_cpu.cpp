@@ -0,0 +1,169 @@
+#include "ssr_cpu.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// defined by ssr_cpu_scalar.cpp, ssr_cpu_sse2.cpp and ssr_cpu_avx2.cpp, without a trace when not compiled in
+extern const ssr_cpu::simd_path ssr_cpu_simd_scalar;
+extern const ssr_cpu::simd_path ssr_cpu_simd_sse2;
+extern const ssr_cpu::simd_path ssr_cpu_simd_avx2;
+
+
+// tiles handed out to the workers, each worker takes its own newest first and steals the others' oldest
+struct ssr_cpu_pool {
+    struct queue {
+        std::mutex mutex;
+        std::deque<uint32_t> tasks;
+    };
+
+    std::vector<std::thread> threads{};
+    std::vector<std::unique_ptr<queue>> queues{};
+    std::mutex mutex{};
+    std::condition_variable wake{};
+    std::condition_variable done{};
+    const std::function<void(uint32_t)> *job = nullptr;
+    uint64_t generation = 0;
+    std::atomic<uint32_t> remaining{0};
+    bool stopping = false;
+
+    explicit ssr_cpu_pool(size_t workers) {
+        // the last queue belongs to the calling thread
+        for (size_t i = 0; i <= workers; ++i) {
+            queues.push_back(std::make_unique<queue>());
+        }
+        for (size_t i = 0; i < workers; ++i) {
+            threads.emplace_back([this, i] { worker(i); });
+        }
+    }
+    ~ssr_cpu_pool() {
+        {
+            std::lock_guard lock{mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    bool pop(size_t index, uint32_t &task) {
+        {
+            queue &own = *queues[index];
+            std::lock_guard lock{own.mutex};
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            queue &victim = *queues[(index + offset) % queues.size()];
+            std::lock_guard lock{victim.mutex};
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    void work(size_t index) {
+        uint32_t task = 0;
+        while (pop(index, task)) {
+            (*job)(task);
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard lock{mutex};
+                done.notify_all();
+            }
+        }
+    }
+    void worker(size_t index) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock lock{mutex};
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            work(index);
+        }
+    }
+
+    void run(uint32_t count, const std::function<void(uint32_t)> &function) {
+        if (count == 0) {
+            return;
+        }
+        {
+            // a worker still draining the previous run may pop these tasks as soon as they are queued,
+            // the job and count they belong to are published first
+            std::lock_guard lock{mutex};
+            job = &function;
+            remaining = count;
+            ++generation;
+            // contiguous blocks keep neighbouring tiles, and their texels, on one worker until stolen
+            const size_t block = (count + queues.size() - 1) / queues.size();
+            for (uint32_t task = 0; task < count; ++task) {
+                queue &target = *queues[task / block];
+                std::lock_guard queue_lock{target.mutex};
+                target.tasks.push_back(task);
+            }
+        }
+        wake.notify_all();
+        work(queues.size() - 1);
+
+        std::unique_lock lock{mutex};
+        done.wait(lock, [&] { return remaining == 0; });
+    }
+};
+
+
+ssr_cpu::ssr_cpu(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    pool = std::make_unique<ssr_cpu_pool>(threads - 1);
+}
+ssr_cpu::~ssr_cpu() = default;
+
+// the avx2 path is built with fma code generation as well
+static bool ssr_cpu_avx2_supported() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    // msvc only builds it with /arch:AVX2, whose binaries already require it
+    return true;
+#endif
+}
+
+const std::vector<const ssr_cpu::simd_path *> &ssr_cpu::simd_paths() {
+    static const std::vector<const simd_path *> paths = [] {
+        std::vector<const simd_path *> result{};
+        if (ssr_cpu_simd_avx2.trace_tile != nullptr && ssr_cpu_avx2_supported()) {
+            result.push_back(&ssr_cpu_simd_avx2);
+        }
+        if (ssr_cpu_simd_sse2.trace_tile != nullptr) {
+            result.push_back(&ssr_cpu_simd_sse2);
+        }
+        result.push_back(&ssr_cpu_simd_scalar);
+        return result;
+    }();
+    return paths;
+}
+
+void ssr_cpu::trace(const frame &input, const output &result) {
+    const uint32_t tiles_x = (input.width + tile_size - 1) / tile_size;
+    const uint32_t tiles_y = (input.height + tile_size - 1) / tile_size;
+    const std::function<void(uint32_t)> trace_tile = [&](uint32_t tile) {
+        simd->trace_tile(quality, input, result, tile);
+    };
+    pool->run(tiles_x * tiles_y, trace_tile);
+}
@@ -0,0 +1,80 @@
+#ifndef SSR_CPU_HPP
+#define SSR_CPU_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct ssr_cpu_pool;
+
+// cpu reference of the raymarch path of ssr_raytrace.glsl
+// (SSR_HIZ_TRAVERSAL_ENABLE=0, SSR_DDA_ENABLE=0, SSR_TILE_CLASSIFY_ENABLE=0, SSR_GLOSSY_ENABLE=0),
+// rows of 8 pixels trace as one packet of simd lanes and screen tiles are spread over a work stealing pool
+// built without fp contraction, every simd path and thread count gives the same bits, see ssr_replay --verify
+// it matches the shader up to float rounding, ssr_replay --reference --baseline of a gpu --write measures by how much
+struct ssr_cpu {
+    // raytrace knobs, the same as ssr_compositor::quality_desc minus the hi-z traversal
+    struct settings {
+        unsigned steps_max = 64;
+        unsigned steps_bsearch_max = 8;
+        float distance_max_vs = 16.0f;
+        float thickness_radius_vs = 0.5f;
+        bool frustum_clip_enable = true;
+        bool bsearch_enable = true;
+        // SSR_TEMPORAL_ENABLE, reseeds the jitter with raytrace_frame
+        bool temporal_enable = false;
+    };
+    // flat inputs, rows top to bottom like the uv of the compositor targets
+    struct frame {
+        uint32_t width;
+        uint32_t height;
+        // unpacked normal_depth_rough, 4 floats per pixel: view space normal xy, ndc01 depth and roughness
+        const float *normal_depth_rough;
+        // 4 floats per pixel
+        const float *scene_colour;
+        // row major, the layout of Ogre::Matrix4
+        std::array<float, 16> projection_matrix;
+        std::array<float, 16> i_projection_matrix;
+        std::array<float, 16> i_view_matrix;
+        float near_clip_plane;
+        float far_clip_plane;
+        // raytrace_frame of ssr/constants, reseeds the jitter with temporal_enable
+        uint32_t raytrace_frame;
+    };
+    // 4 floats per pixel each, either may be null
+    struct output {
+        // uv, ndc01 depth and hit flag returned by intersection_raymarch_uv
+        float *hit_uv;
+        // scene colour blended with the reflection, what the full resolution pipeline outputs
+        float *colour;
+    };
+    static constexpr uint32_t tile_size = 16;
+    // lanes of a ray packet
+    static constexpr uint32_t packet_size = 8;
+
+    // the trace of one tile with one instruction set, scalar is always built, sse2 and avx2 on x86
+    struct simd_path {
+        const char *name;
+        void (*trace_tile)(const settings &quality, const frame &input, const output &result, uint32_t tile);
+    };
+    // the paths built in that the cpu runs, fastest first
+    static const std::vector<const simd_path *> &simd_paths();
+
+    settings quality{};
+    const simd_path *simd = simd_paths().front();
+
+    // threads 0 uses every hardware thread, the calling thread always works as well
+    explicit ssr_cpu(size_t threads = 0);
+    ~ssr_cpu();
+    ssr_cpu(const ssr_cpu &) = delete;
+    ssr_cpu &operator=(const ssr_cpu &) = delete;
+
+    void trace(const frame &input, const output &result);
+
+private:
+    std::unique_ptr<ssr_cpu_pool> pool;
+};
+
+#endif
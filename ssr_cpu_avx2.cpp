@@ -0,0 +1,12 @@
+// the avx2 path of ssr_cpu, built with avx2 and fma code generation when SSR_CPU_AVX2 is on in CMakeLists.txt
+#include "ssr_cpu.hpp"
+
+extern const ssr_cpu::simd_path ssr_cpu_simd_avx2;
+#if defined(__AVX2__)
+#define SSR_CPU_AVX2 1
+#include "ssr_cpu_kernel.hpp"
+
+const ssr_cpu::simd_path ssr_cpu_simd_avx2{"avx2", ssr_cpu_trace_tile};
+#else
+const ssr_cpu::simd_path ssr_cpu_simd_avx2{"avx2", nullptr};
+#endif
@@ -0,0 +1,686 @@
+// the tile trace of ssr_cpu, the including file picks the simd path with SSR_CPU_SSE2 or SSR_CPU_AVX2
+
+#ifndef SSR_CPU_KERNEL_HPP
+#define SSR_CPU_KERNEL_HPP
+
+#include "ssr_cpu.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(SSR_CPU_AVX2)
+#include <immintrin.h>
+#elif defined(SSR_CPU_SSE2)
+#include <emmintrin.h>
+#endif
+
+// every path defines the same types differently, they stay local to the file including them
+namespace {
+
+
+// the constants of ssr_raytrace.glsl and ssr_reflection_weight.glsl
+static constexpr float ssr_cpu_infinity = std::numeric_limits<float>::infinity();
+static constexpr float ssr_cpu_epsilon = 0.0001f;
+static constexpr float ssr_cpu_far_max_ndc = 1.0f - ssr_cpu_epsilon;
+static constexpr float ssr_cpu_jitter_scale = 0.1f;
+static constexpr float ssr_cpu_roughness_power = 1.2f;
+static constexpr float ssr_cpu_fresnel_power = 1.2f;
+static constexpr float ssr_cpu_luminance_power = 2.2f;
+static constexpr float ssr_cpu_front_ray_discard_power = 0.8f;
+static constexpr float ssr_cpu_reflection_power_bias = 2.0f;
+
+
+// 8 float lanes, masks are lanes with every bit set
+struct float8 {
+#if defined(SSR_CPU_AVX2)
+    __m256 v;
+#elif defined(SSR_CPU_SSE2)
+    __m128 lo;
+    __m128 hi;
+#else
+    std::array<float, 8> v;
+#endif
+};
+// 8 int32 lanes, texel indices float8 can't hold exactly past 2^24
+struct index8 {
+#if defined(SSR_CPU_AVX2)
+    __m256i v;
+#else
+    std::array<int32_t, 8> v;
+#endif
+};
+
+#if defined(SSR_CPU_AVX2)
+static inline float8 f8(float value) { return {_mm256_set1_ps(value)}; }
+static inline float8 f8_load(const float *values) { return {_mm256_loadu_ps(values)}; }
+static inline void f8_store(float *values, float8 a) { _mm256_storeu_ps(values, a.v); }
+static inline float8 operator+(float8 a, float8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+static inline float8 operator-(float8 a, float8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+static inline float8 operator*(float8 a, float8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+static inline float8 operator/(float8 a, float8 b) { return {_mm256_div_ps(a.v, b.v)}; }
+static inline float8 f8_min(float8 a, float8 b) { return {_mm256_min_ps(a.v, b.v)}; }
+static inline float8 f8_max(float8 a, float8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+static inline float8 f8_sqrt(float8 a) { return {_mm256_sqrt_ps(a.v)}; }
+static inline float8 f8_floor(float8 a) { return {_mm256_floor_ps(a.v)}; }
+static inline float8 f8_ge(float8 a, float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+static inline float8 f8_le(float8 a, float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+static inline float8 f8_lt(float8 a, float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+static inline float8 f8_gt(float8 a, float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+static inline float8 f8_and(float8 a, float8 b) { return {_mm256_and_ps(a.v, b.v)}; }
+static inline float8 f8_or(float8 a, float8 b) { return {_mm256_or_ps(a.v, b.v)}; }
+static inline float8 f8_andnot(float8 a, float8 b) { return {_mm256_andnot_ps(a.v, b.v)}; }
+static inline float8 f8_select(float8 mask, float8 a, float8 b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+static inline bool f8_any(float8 mask) { return _mm256_movemask_ps(mask.v) != 0; }
+// (y * width + x) * 4 of every lane, x and y are whole texels
+static inline index8 i8_texel(float8 x, float8 y, int32_t width) {
+    const __m256i row = _mm256_mullo_epi32(_mm256_cvttps_epi32(y.v), _mm256_set1_epi32(width));
+    return {_mm256_slli_epi32(_mm256_add_epi32(row, _mm256_cvttps_epi32(x.v)), 2)};
+}
+static inline float8 f8_gather(const float *base, index8 index) {
+    return {_mm256_i32gather_ps(base, index.v, 4)};
+}
+#elif defined(SSR_CPU_SSE2)
+static inline float8 f8(float value) { return {_mm_set1_ps(value), _mm_set1_ps(value)}; }
+static inline float8 f8_load(const float *values) { return {_mm_loadu_ps(values), _mm_loadu_ps(values + 4)}; }
+static inline void f8_store(float *values, float8 a) { _mm_storeu_ps(values, a.lo); _mm_storeu_ps(values + 4, a.hi); }
+static inline float8 operator+(float8 a, float8 b) { return {_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)}; }
+static inline float8 operator-(float8 a, float8 b) { return {_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi)}; }
+static inline float8 operator*(float8 a, float8 b) { return {_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)}; }
+static inline float8 operator/(float8 a, float8 b) { return {_mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi)}; }
+static inline float8 f8_min(float8 a, float8 b) { return {_mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi)}; }
+static inline float8 f8_max(float8 a, float8 b) { return {_mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi)}; }
+static inline float8 f8_sqrt(float8 a) { return {_mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi)}; }
+static inline __m128 f4_floor(__m128 a) {
+    // truncation rounds negative values up, step those back down
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    const __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.0f)));
+    // from 2^23 on every float is whole, and past int32 the truncation saturates
+    const __m128 whole = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), a), _mm_set1_ps(8388608.0f));
+    return _mm_or_ps(_mm_and_ps(whole, a), _mm_andnot_ps(whole, floored));
+}
+static inline float8 f8_floor(float8 a) { return {f4_floor(a.lo), f4_floor(a.hi)}; }
+static inline float8 f8_ge(float8 a, float8 b) { return {_mm_cmpge_ps(a.lo, b.lo), _mm_cmpge_ps(a.hi, b.hi)}; }
+static inline float8 f8_le(float8 a, float8 b) { return {_mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi)}; }
+static inline float8 f8_lt(float8 a, float8 b) { return {_mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi)}; }
+static inline float8 f8_gt(float8 a, float8 b) { return {_mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi)}; }
+static inline float8 f8_and(float8 a, float8 b) { return {_mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi)}; }
+static inline float8 f8_or(float8 a, float8 b) { return {_mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi)}; }
+static inline float8 f8_andnot(float8 a, float8 b) { return {_mm_andnot_ps(a.lo, b.lo), _mm_andnot_ps(a.hi, b.hi)}; }
+static inline float8 f8_select(float8 mask, float8 a, float8 b) {
+    return {
+        _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo)),
+        _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi)),
+    };
+}
+static inline bool f8_any(float8 mask) { return (_mm_movemask_ps(mask.lo) | _mm_movemask_ps(mask.hi)) != 0; }
+static inline index8 i8_texel(float8 x, float8 y, int32_t width) {
+    alignas(16) float xs[8];
+    alignas(16) float ys[8];
+    f8_store(xs, x);
+    f8_store(ys, y);
+    index8 result{};
+    for (size_t i = 0; i < 8; ++i) {
+        result.v[i] = (int32_t(ys[i]) * width + int32_t(xs[i])) * 4;
+    }
+    return result;
+}
+static inline float8 f8_gather(const float *base, index8 index) {
+    const std::array<int32_t, 8> &i = index.v;
+    return {
+        _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]),
+        _mm_setr_ps(base[i[4]], base[i[5]], base[i[6]], base[i[7]]),
+    };
+}
+#else
+template<typename F>
+static inline float8 f8_map(float8 a, float8 b, F f) {
+    float8 result{};
+    for (size_t i = 0; i < 8; ++i) {
+        result.v[i] = f(a.v[i], b.v[i]);
+    }
+    return result;
+}
+static inline float f1_mask(bool value) {
+    uint32_t bits = value ? 0xffffffffu : 0u;
+    float mask;
+    std::memcpy(&mask, &bits, sizeof(mask));
+    return mask;
+}
+static inline uint32_t f1_bits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+static inline float f1_from_bits(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+static inline float8 f8(float value) { float8 result{}; result.v.fill(value); return result; }
+static inline float8 f8_load(const float *values) { float8 result{}; std::copy(values, values + 8, result.v.begin()); return result; }
+static inline void f8_store(float *values, float8 a) { std::copy(a.v.begin(), a.v.end(), values); }
+static inline float8 operator+(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return x + y; }); }
+static inline float8 operator-(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return x - y; }); }
+static inline float8 operator*(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return x * y; }); }
+static inline float8 operator/(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return x / y; }); }
+static inline float8 f8_min(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+static inline float8 f8_max(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+static inline float8 f8_sqrt(float8 a) { return f8_map(a, a, [](float x, float) { return std::sqrt(x); }); }
+static inline float8 f8_floor(float8 a) { return f8_map(a, a, [](float x, float) { return std::floor(x); }); }
+static inline float8 f8_ge(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return f1_mask(x >= y); }); }
+static inline float8 f8_le(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return f1_mask(x <= y); }); }
+static inline float8 f8_lt(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return f1_mask(x < y); }); }
+static inline float8 f8_gt(float8 a, float8 b) { return f8_map(a, b, [](float x, float y) { return f1_mask(x > y); }); }
+static inline float8 f8_and(float8 a, float8 b) {
+    return f8_map(a, b, [](float x, float y) { return f1_from_bits(f1_bits(x) & f1_bits(y)); });
+}
+static inline float8 f8_or(float8 a, float8 b) {
+    return f8_map(a, b, [](float x, float y) { return f1_from_bits(f1_bits(x) | f1_bits(y)); });
+}
+static inline float8 f8_andnot(float8 a, float8 b) {
+    return f8_map(a, b, [](float x, float y) { return f1_from_bits(~f1_bits(x) & f1_bits(y)); });
+}
+static inline float8 f8_select(float8 mask, float8 a, float8 b) {
+    float8 result{};
+    for (size_t i = 0; i < 8; ++i) {
+        result.v[i] = f1_bits(mask.v[i]) != 0 ? a.v[i] : b.v[i];
+    }
+    return result;
+}
+static inline bool f8_any(float8 mask) {
+    return std::any_of(mask.v.begin(), mask.v.end(), [](float x) { return f1_bits(x) != 0; });
+}
+static inline index8 i8_texel(float8 x, float8 y, int32_t width) {
+    index8 result{};
+    for (size_t i = 0; i < 8; ++i) {
+        result.v[i] = (int32_t(y.v[i]) * width + int32_t(x.v[i])) * 4;
+    }
+    return result;
+}
+static inline float8 f8_gather(const float *base, index8 index) {
+    float8 result{};
+    for (size_t i = 0; i < 8; ++i) {
+        result.v[i] = base[index.v[i]];
+    }
+    return result;
+}
+#endif
+
+static inline float8 f8_mix(float8 a, float8 b, float8 w) {
+    return a + (b - a) * w;
+}
+static inline float8 f8_clamp(float8 a, float8 low, float8 high) {
+    return f8_min(f8_max(a, low), high);
+}
+
+
+struct float3 {
+    float x;
+    float y;
+    float z;
+};
+static inline float3 operator+(float3 a, float3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+static inline float3 operator-(float3 a, float3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+static inline float3 operator*(float3 a, float b) { return {a.x * b, a.y * b, a.z * b}; }
+static inline float3 operator*(float3 a, float3 b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+static inline float ssr_cpu_dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline float3 ssr_cpu_normalize(float3 a) { return a * (1.0f / std::sqrt(ssr_cpu_dot(a, a))); }
+static inline float ssr_cpu_fract(float a) { return a - std::floor(a); }
+static inline float ssr_cpu_sign(float a) { return a > 0.0f ? 1.0f : (a < 0.0f ? -1.0f : 0.0f); }
+
+// row major matrix times (v, w), like Ogre::Matrix4 and the glsl uniforms it uploads
+static inline std::array<float, 4> ssr_cpu_transform(const std::array<float, 16> &m, float3 v, float w) {
+    return {
+        m[0] * v.x + m[1] * v.y + m[2] * v.z + m[3] * w,
+        m[4] * v.x + m[5] * v.y + m[6] * v.z + m[7] * w,
+        m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11] * w,
+        m[12] * v.x + m[13] * v.y + m[14] * v.z + m[15] * w,
+    };
+}
+
+
+// source: https://zznewclear13.github.io/posts/screen-space-reflection-en/#frustum-clipping
+static float3 ssr_cpu_segment_end_clip_vs_from(float3 origin_vs, float3 end_vs, float near_clip, float far_clip, float half_x, float half_y) {
+    origin_vs.z *= -1.0f;
+    end_vs.z *= -1.0f;
+
+    const float3 dir = end_vs - origin_vs;
+    const float3 sign_dir = {ssr_cpu_sign(dir.x), ssr_cpu_sign(dir.y), ssr_cpu_sign(dir.z)};
+
+    const float nf_slab = sign_dir.z * (far_clip - near_clip) * 0.5f + (far_clip + near_clip) * 0.5f;
+    float len_z = (nf_slab - origin_vs.z) / dir.z;
+    if (dir.z == 0.0f) len_z = ssr_cpu_infinity;
+
+    const float ss_x = ssr_cpu_sign(dir.x - half_x * dir.z) * half_x;
+    const float ss_y = ssr_cpu_sign(dir.y - half_y * dir.z) * half_y;
+    const float denom_x = ss_x * dir.z - dir.x;
+    const float denom_y = ss_y * dir.z - dir.y;
+    float len_x = (origin_vs.x - ss_x * origin_vs.z) / denom_x;
+    float len_y = (origin_vs.y - ss_y * origin_vs.z) / denom_y;
+    if (len_x < 0.0f || denom_x == 0.0f) len_x = ssr_cpu_infinity;
+    if (len_y < 0.0f || denom_y == 0.0f) len_y = ssr_cpu_infinity;
+
+    const float len = std::min(std::min(1.0f, len_z), std::min(len_x, len_y));
+    float3 clipped_vs = origin_vs + dir * len;
+    clipped_vs.z *= -1.0f;
+    return clipped_vs;
+}
+
+// source: http://www.jcgt.org/published/0009/03/02/
+static std::array<uint32_t, 3> ssr_cpu_pcg3d(std::array<uint32_t, 3> v) {
+    for (auto &x : v) {
+        x = x * 1664525u + 1013904223u;
+    }
+    v[0] += v[1] * v[2];
+    v[1] += v[2] * v[0];
+    v[2] += v[0] * v[1];
+    for (auto &x : v) {
+        x ^= x >> 16u;
+    }
+    v[0] += v[1] * v[2];
+    v[1] += v[2] * v[0];
+    v[2] += v[0] * v[1];
+    return v;
+}
+// source: https://www.shadertoy.com/view/4djSRW
+static float3 ssr_cpu_hash33(float3 p3) {
+    p3 = {ssr_cpu_fract(p3.x * 0.1031f), ssr_cpu_fract(p3.y * 0.1030f), ssr_cpu_fract(p3.z * 0.0973f)};
+    const float d = ssr_cpu_dot(p3, float3{p3.y + 33.33f, p3.x + 33.33f, p3.z + 33.33f});
+    p3 = p3 + float3{d, d, d};
+    return {
+        ssr_cpu_fract((p3.x + p3.y) * p3.z),
+        ssr_cpu_fract((p3.x + p3.x) * p3.y),
+        ssr_cpu_fract((p3.y + p3.x) * p3.x),
+    };
+}
+static float3 ssr_cpu_jitter(float3 position_ws, uint32_t raytrace_frame) {
+    const float uint_max = float(std::numeric_limits<uint32_t>::max());
+    const float3 hash = ssr_cpu_hash33(position_ws);
+    const auto bits = ssr_cpu_pcg3d({
+        uint32_t(std::min(hash.x * uint_max, 4294967040.0f)),
+        uint32_t(std::min(hash.y * uint_max, 4294967040.0f)),
+        uint32_t(std::min(hash.z * uint_max, 4294967040.0f)) ^ raytrace_frame,
+    });
+    return {
+        float(bits[0]) / uint_max * 2.0f - 1.0f,
+        float(bits[1]) / uint_max * 2.0f - 1.0f,
+        float(bits[2]) / uint_max * 2.0f - 1.0f,
+    };
+}
+
+
+// clip space position of a packet, one float8 per component
+struct float8x4 {
+    float8 x;
+    float8 y;
+    float8 z;
+    float8 w;
+};
+static inline float8x4 f8x4_mix(const float8x4 &a, const float8x4 &b, float8 w) {
+    return {f8_mix(a.x, b.x, w), f8_mix(a.y, b.y, w), f8_mix(a.z, b.z, w), f8_mix(a.w, b.w, w)};
+}
+
+// nearest, clamped normal_depth_rough reads at the uv of every lane
+struct ssr_cpu_ndr_sample {
+    float8 normal_x;
+    float8 normal_y;
+    float8 normal_z;
+    float8 depth_ndc01;
+};
+struct ssr_cpu_sampler {
+    const float *texels;
+    int32_t row_texels;
+    float8 width;
+    float8 height;
+    float8 max_x;
+    float8 max_y;
+
+    index8 index(float8 u, float8 v) const {
+        const float8 x = f8_clamp(f8_floor(u * width), f8(0.0f), max_x);
+        const float8 y = f8_clamp(f8_floor(v * height), f8(0.0f), max_y);
+        return i8_texel(x, y, row_texels);
+    }
+    ssr_cpu_ndr_sample ndr(float8 u, float8 v) const {
+        const index8 base = index(u, v);
+        ssr_cpu_ndr_sample result{};
+        result.normal_x = f8_gather(texels, base);
+        result.normal_y = f8_gather(texels + 1, base);
+        result.depth_ndc01 = f8_gather(texels + 2, base);
+        result.normal_z = f8_sqrt(f8_max(f8(1.0f) - result.normal_x * result.normal_x - result.normal_y * result.normal_y, f8(0.0f)));
+        return result;
+    }
+};
+
+// intersection_raymarch_uv with both binary searches of ssr_raytrace.glsl for a packet
+struct ssr_cpu_packet {
+    float8x4 origin_cs;
+    float8x4 end_cs;
+    float8x4 origin_front_cs;
+    float8x4 end_front_cs;
+    float8 direction_x;
+    float8 direction_y;
+    float8 direction_z;
+    float8 valid;
+};
+struct ssr_cpu_hits {
+    float8 u;
+    float8 v;
+    float8 depth_ndc01;
+    float8 hit;
+};
+
+static inline void ssr_cpu_sample_uv(const float8x4 &position_cs, float8 &u, float8 &v, float8 &depth_ndc) {
+    const float8 inverse_w = f8(1.0f) / position_cs.w;
+    depth_ndc = position_cs.z * inverse_w;
+    u = position_cs.x * inverse_w * f8(0.5f) + f8(0.5f);
+    v = f8(0.5f) - position_cs.y * inverse_w * f8(0.5f);
+}
+
+// intersection_binary_search_uv on the lanes in search, intersection_binary_minimization_uv on the
+// ones in minimize, both take the same steps and only differ in which samples they keep
+static ssr_cpu_hits ssr_cpu_binary_search(
+    const ssr_cpu::settings &quality,
+    const ssr_cpu_sampler &sampler,
+    const ssr_cpu_packet &packet,
+    float8 search,
+    float8 minimize,
+    float8 min_depth_difference_ndc,
+    float8 w,
+    float8 prev_w
+) {
+    const float8 lanes = f8_or(search, minimize);
+    ssr_cpu_hits result{f8(0.0f), f8(0.0f), f8(0.0f), f8(0.0f)};
+    for (unsigned i = 0; i < quality.steps_bsearch_max; ++i) {
+        const float8 mid_w = (w + prev_w) * f8(0.5f);
+
+        const float8x4 position_cs = f8x4_mix(packet.origin_cs, packet.end_cs, mid_w);
+        const float8x4 position_front_cs = f8x4_mix(packet.origin_front_cs, packet.end_front_cs, mid_w);
+
+        float8 sample_u, sample_v, ray_depth_ndc;
+        ssr_cpu_sample_uv(position_cs, sample_u, sample_v, ray_depth_ndc);
+        const float8 ray_front_depth_ndc = position_front_cs.z / position_front_cs.w;
+
+        const float8 sample_depth_ndc01 = sampler.ndr(sample_u, sample_v).depth_ndc01;
+        const float8 sample_depth_ndc = sample_depth_ndc01 * f8(2.0f) - f8(1.0f);
+        const float8 depth_difference_ndc = ray_depth_ndc - sample_depth_ndc;
+
+        const float8 behind = f8_and(lanes, f8_ge(depth_difference_ndc, f8(0.0f)));
+        const float8 front = f8_and(behind, f8_le(ray_front_depth_ndc, sample_depth_ndc));
+        const float8 keep = f8_and(front, f8_or(search, f8_lt(depth_difference_ndc, min_depth_difference_ndc)));
+
+        result.u = f8_select(keep, sample_u, result.u);
+        result.v = f8_select(keep, sample_v, result.v);
+        result.depth_ndc01 = f8_select(keep, sample_depth_ndc01, result.depth_ndc01);
+        result.hit = f8_select(keep, f8(1.0f), result.hit);
+        min_depth_difference_ndc = f8_select(f8_and(keep, minimize), depth_difference_ndc, min_depth_difference_ndc);
+
+        // behind the surface w moves to mid_w, halfway back towards prev_w when also behind its front
+        const float8 thick = f8_andnot(front, behind);
+        w = f8_select(behind, f8_select(thick, (mid_w + prev_w) * f8(0.5f), mid_w), w);
+        prev_w = f8_select(f8_andnot(behind, lanes), mid_w, prev_w);
+    }
+    return result;
+}
+
+static ssr_cpu_hits ssr_cpu_raymarch(const ssr_cpu::settings &quality, const ssr_cpu_sampler &sampler, const ssr_cpu_packet &packet) {
+    const float8 dw = f8(1.0f / float(quality.steps_max));
+    float8 w = f8(0.0f);
+    float8 potential_w = f8(0.0f);
+    float8 min_depth_difference_ndc = f8(ssr_cpu_infinity);
+    float8 hit_w = f8(0.0f);
+
+    ssr_cpu_hits result{f8(0.0f), f8(0.0f), f8(0.0f), f8(0.0f)};
+    float8 active = packet.valid;
+    float8 hit = f8(0.0f);
+    for (unsigned i = 0; i < quality.steps_max && f8_any(active); ++i) {
+        w = w + dw;
+
+        const float8x4 position_cs = f8x4_mix(packet.origin_cs, packet.end_cs, w);
+        const float8x4 position_front_cs = f8x4_mix(packet.origin_front_cs, packet.end_front_cs, w);
+
+        float8 sample_u, sample_v, ray_depth_ndc;
+        ssr_cpu_sample_uv(position_cs, sample_u, sample_v, ray_depth_ndc);
+        const float8 ray_front_depth_ndc = position_front_cs.z / position_front_cs.w;
+
+        const ssr_cpu_ndr_sample nd = sampler.ndr(sample_u, sample_v);
+        const float8 sample_depth_ndc = nd.depth_ndc01 * f8(2.0f) - f8(1.0f);
+        const float8 depth_difference_ndc = ray_depth_ndc - sample_depth_ndc;
+
+        // the last sample of a lane is its result when nothing is hit
+        result.u = f8_select(active, sample_u, result.u);
+        result.v = f8_select(active, sample_v, result.v);
+        result.depth_ndc01 = f8_select(active, nd.depth_ndc01, result.depth_ndc01);
+
+        const float8 facing = f8_lt(
+            packet.direction_x * nd.normal_x + packet.direction_y * nd.normal_y + packet.direction_z * nd.normal_z,
+            f8(0.0f)
+        );
+        const float8 behind = f8_and(active, f8_and(f8_ge(depth_difference_ndc, f8(0.0f)), facing));
+        const float8 front = f8_and(behind, f8_le(ray_front_depth_ndc, sample_depth_ndc));
+        const float8 closer = f8_and(f8_andnot(front, behind), f8_lt(depth_difference_ndc, min_depth_difference_ndc));
+
+        hit = f8_or(hit, front);
+        hit_w = f8_select(front, w, hit_w);
+        min_depth_difference_ndc = f8_select(closer, depth_difference_ndc, min_depth_difference_ndc);
+        potential_w = f8_select(closer, w, potential_w);
+        active = f8_andnot(front, active);
+    }
+    result.hit = f8_select(hit, f8(1.0f), f8(0.0f));
+    if (!quality.bsearch_enable) {
+        return result;
+    }
+
+    const float8 minimize = f8_andnot(hit, f8_and(packet.valid, f8_gt(potential_w, f8(0.0f))));
+    const float8 search_w = f8_select(hit, hit_w, potential_w);
+    const ssr_cpu_hits refined = ssr_cpu_binary_search(
+        quality, sampler, packet, hit, minimize, min_depth_difference_ndc, search_w, search_w - dw
+    );
+    const float8 refine = f8_gt(refined.hit, f8(0.0f));
+    result.u = f8_select(refine, refined.u, result.u);
+    result.v = f8_select(refine, refined.v, result.v);
+    result.depth_ndc01 = f8_select(refine, refined.depth_ndc01, result.depth_ndc01);
+    // a lane that hit while marching keeps its hit when the search finds nothing closer
+    result.hit = f8_select(f8_or(refine, hit), f8(1.0f), f8(0.0f));
+    return result;
+}
+
+
+// traces the pixels of one tile_size square of input into result
+static void ssr_cpu_trace_tile(
+    const ssr_cpu::settings &quality,
+    const ssr_cpu::frame &input,
+    const ssr_cpu::output &result,
+    uint32_t tile
+) {
+    constexpr uint32_t tile_size = ssr_cpu::tile_size;
+    constexpr uint32_t packet_size = ssr_cpu::packet_size;
+    const uint32_t tiles_x = (input.width + tile_size - 1) / tile_size;
+
+    const ssr_cpu_sampler sampler{
+        input.normal_depth_rough,
+        int32_t(input.width),
+        f8(float(input.width)),
+        f8(float(input.height)),
+        f8(float(input.width - 1)),
+        f8(float(input.height - 1)),
+    };
+    const float half_x = 1.0f / input.projection_matrix[0];
+    const float half_y = 1.0f / input.projection_matrix[5];
+
+    const uint32_t x_begin = (tile % tiles_x) * tile_size;
+    const uint32_t y_begin = (tile / tiles_x) * tile_size;
+    const uint32_t x_end = std::min(x_begin + tile_size, input.width);
+    const uint32_t y_end = std::min(y_begin + tile_size, input.height);
+
+    for (uint32_t y = y_begin; y < y_end; ++y) {
+        for (uint32_t x_packet = x_begin; x_packet < x_end; x_packet += packet_size) {
+            const uint32_t lanes = std::min(packet_size, x_end - x_packet);
+
+            // per lane setup, everything main() does before intersection_raymarch_uv
+            alignas(32) float lane_valid[packet_size]{};
+            alignas(32) float lane_cs[16][packet_size]{};
+            alignas(32) float lane_direction[3][packet_size]{};
+            float3 lane_view_direction[packet_size]{};
+            float3 lane_reflection_direction[packet_size]{};
+            float3 lane_normal[packet_size]{};
+            float lane_roughness_factor[packet_size]{};
+            for (uint32_t lane = 0; lane < packet_size; ++lane) {
+                lane_cs[3][lane] = lane_cs[7][lane] = lane_cs[11][lane] = lane_cs[15][lane] = 1.0f;
+                if (lane >= lanes) {
+                    continue;
+                }
+                const uint32_t x = x_packet + lane;
+                const float *ndr = input.normal_depth_rough + (size_t(y) * input.width + x) * 4;
+                const float depth_ndc01 = ndr[2];
+                if (depth_ndc01 > ssr_cpu_far_max_ndc) {
+                    continue;
+                }
+                const float u = (float(x) + 0.5f) / float(input.width);
+                const float v = (float(y) + 0.5f) / float(input.height);
+                const float3 normal_vs = {ndr[0], ndr[1], std::sqrt(std::max(1.0f - ndr[0] * ndr[0] - ndr[1] * ndr[1], 0.0f))};
+
+                const auto position_h = ssr_cpu_transform(
+                    input.i_projection_matrix,
+                    {u * 2.0f - 1.0f, 1.0f - v * 2.0f, depth_ndc01 * 2.0f - 1.0f},
+                    1.0f
+                );
+                const float3 position_vs = float3{position_h[0], position_h[1], position_h[2]} * (1.0f / position_h[3]);
+                const float3 view_direction_vs = ssr_cpu_normalize(position_vs);
+                const float3 reflection_direction_vs = ssr_cpu_normalize(
+                    view_direction_vs - normal_vs * (2.0f * ssr_cpu_dot(normal_vs, view_direction_vs))
+                );
+                const float roughness_factor = std::pow(1.0f - ndr[3], ssr_cpu_roughness_power);
+
+                const auto position_ws = ssr_cpu_transform(input.i_view_matrix, position_vs, 1.0f);
+                const float3 jitter = ssr_cpu_jitter(
+                    {position_ws[0], position_ws[1], position_ws[2]},
+                    quality.temporal_enable ? input.raytrace_frame : 0
+                );
+                const float3 direction_vs = reflection_direction_vs
+                    + normal_vs * jitter * ((1.0f - roughness_factor) * ssr_cpu_jitter_scale);
+
+                float3 end_vs = position_vs + direction_vs * quality.distance_max_vs;
+                if (quality.frustum_clip_enable) {
+                    end_vs = ssr_cpu_segment_end_clip_vs_from(
+                        position_vs, end_vs, input.near_clip_plane, input.far_clip_plane, half_x, half_y
+                    );
+                }
+                const float3 front = {0.0f, 0.0f, quality.thickness_radius_vs};
+                const std::array<std::array<float, 4>, 4> corners{
+                    ssr_cpu_transform(input.projection_matrix, position_vs, 1.0f),
+                    ssr_cpu_transform(input.projection_matrix, end_vs, 1.0f),
+                    ssr_cpu_transform(input.projection_matrix, position_vs + front, 1.0f),
+                    ssr_cpu_transform(input.projection_matrix, end_vs + front, 1.0f),
+                };
+                for (size_t corner = 0; corner < 4; ++corner) {
+                    for (size_t component = 0; component < 4; ++component) {
+                        lane_cs[corner * 4 + component][lane] = corners[corner][component];
+                    }
+                }
+                lane_direction[0][lane] = direction_vs.x;
+                lane_direction[1][lane] = direction_vs.y;
+                lane_direction[2][lane] = direction_vs.z;
+                lane_view_direction[lane] = view_direction_vs;
+                lane_reflection_direction[lane] = reflection_direction_vs;
+                lane_normal[lane] = normal_vs;
+                lane_roughness_factor[lane] = roughness_factor;
+                lane_valid[lane] = 1.0f;
+            }
+
+            auto load4 = [&](size_t corner) {
+                return float8x4{
+                    f8_load(lane_cs[corner * 4 + 0]),
+                    f8_load(lane_cs[corner * 4 + 1]),
+                    f8_load(lane_cs[corner * 4 + 2]),
+                    f8_load(lane_cs[corner * 4 + 3]),
+                };
+            };
+            const ssr_cpu_packet packet{
+                load4(0),
+                load4(1),
+                load4(2),
+                load4(3),
+                f8_load(lane_direction[0]),
+                f8_load(lane_direction[1]),
+                f8_load(lane_direction[2]),
+                f8_gt(f8_load(lane_valid), f8(0.0f)),
+            };
+            const ssr_cpu_hits hits = ssr_cpu_raymarch(quality, sampler, packet);
+
+            alignas(32) float hit_u[packet_size];
+            alignas(32) float hit_v[packet_size];
+            alignas(32) float hit_depth_ndc01[packet_size];
+            alignas(32) float hit[packet_size];
+            f8_store(hit_u, hits.u);
+            f8_store(hit_v, hits.v);
+            f8_store(hit_depth_ndc01, hits.depth_ndc01);
+            f8_store(hit, hits.hit);
+
+            // per lane shading, everything main() does after intersection_raymarch_uv
+            for (uint32_t lane = 0; lane < lanes; ++lane) {
+                const size_t pixel = size_t(y) * input.width + x_packet + lane;
+                const float *scene_color = input.scene_colour + pixel * 4;
+                if (lane_valid[lane] == 0.0f) {
+                    if (result.hit_uv != nullptr) {
+                        std::fill(result.hit_uv + pixel * 4, result.hit_uv + pixel * 4 + 4, 0.0f);
+                    }
+                    if (result.colour != nullptr) {
+                        std::copy(scene_color, scene_color + 4, result.colour + pixel * 4);
+                    }
+                    continue;
+                }
+                if (result.hit_uv != nullptr) {
+                    float *out = result.hit_uv + pixel * 4;
+                    out[0] = hit_u[lane];
+                    out[1] = hit_v[lane];
+                    out[2] = hit_depth_ndc01[lane];
+                    out[3] = hit[lane];
+                }
+                if (result.colour == nullptr) {
+                    continue;
+                }
+
+                const uint32_t hit_x = uint32_t(std::clamp(std::floor(hit_u[lane] * float(input.width)), 0.0f, float(input.width - 1)));
+                const uint32_t hit_y = uint32_t(std::clamp(std::floor(hit_v[lane] * float(input.height)), 0.0f, float(input.height - 1)));
+                const float *hit_color = input.scene_colour + (size_t(hit_y) * input.width + hit_x) * 4;
+
+                auto luminance = [](const float *color) {
+                    return color[0] * 0.2126f + color[1] * 0.7152f + color[2] * 0.0722f;
+                };
+                const float fresnel_factor = std::pow(
+                    1.0f - std::max(-ssr_cpu_dot(lane_view_direction[lane], lane_normal[lane]), 0.0f),
+                    ssr_cpu_fresnel_power
+                );
+                const float luminance_factor = std::pow(
+                    luminance(hit_color) / (luminance(scene_color) + 1.0f),
+                    ssr_cpu_luminance_power
+                );
+                const float front_ray_factor = std::pow(
+                    1.0f - std::max(lane_reflection_direction[lane].z, 0.0f),
+                    ssr_cpu_front_ray_discard_power
+                );
+                const float roughness_factor = lane_roughness_factor[lane];
+                float reflection_factor = front_ray_factor * std::pow(
+                    fresnel_factor * (luminance_factor + roughness_factor) * roughness_factor,
+                    1.0f / ssr_cpu_reflection_power_bias
+                );
+                if (hit[lane] == 0.0f && hit_depth_ndc01[lane] <= ssr_cpu_far_max_ndc) {
+                    reflection_factor = 0.0f;
+                }
+
+                float *out = result.colour + pixel * 4;
+                for (size_t c = 0; c < 4; ++c) {
+                    out[c] = scene_color[c] + (hit_color[c] - scene_color[c]) * reflection_factor;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+#endif
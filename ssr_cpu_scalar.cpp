@@ -0,0 +1,5 @@
+// the scalar path of ssr_cpu, one float per lane, built everywhere
+#include "ssr_cpu_kernel.hpp"
+
+extern const ssr_cpu::simd_path ssr_cpu_simd_scalar;
+const ssr_cpu::simd_path ssr_cpu_simd_scalar{"scalar", ssr_cpu_trace_tile};
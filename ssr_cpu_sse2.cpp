@@ -0,0 +1,12 @@
+// the sse2 path of ssr_cpu, two 4 lane halves, built on x86
+#include "ssr_cpu.hpp"
+
+extern const ssr_cpu::simd_path ssr_cpu_simd_sse2;
+#if defined(__SSE2__) || defined(_M_X64)
+#define SSR_CPU_SSE2 1
+#include "ssr_cpu_kernel.hpp"
+
+const ssr_cpu::simd_path ssr_cpu_simd_sse2{"sse2", ssr_cpu_trace_tile};
+#else
+const ssr_cpu::simd_path ssr_cpu_simd_sse2{"sse2", nullptr};
+#endif
@@ -0,0 +1,57 @@
+#include "ssr_governor.hpp"
+
+#include <algorithm>
+
+
+bool ssr_governor::update(float raytrace_ms, bool render_scale_enabled) {
+    measured_ms = raytrace_ms;
+    if (!enabled) {
+        return false;
+    }
+    if (frames_settling > 0) {
+        --frames_settling;
+        return false;
+    }
+    frames_over = raytrace_ms > budget_ms * (1.0f + hysteresis) ? frames_over + 1 : 0;
+    frames_under = raytrace_ms < budget_ms * (1.0f - hysteresis) ? frames_under + 1 : 0;
+
+    const size_t previous_level = level;
+    const float previous_render_scale = render_scale;
+    if (frames_over >= frames_to_step) {
+        // the render scale changes for free, a level swaps the raytrace for another permutation
+        if (render_scale_enabled && render_scale > render_scale_min) {
+            render_scale = std::max(render_scale - render_scale_step, render_scale_min);
+        } else if (level > 0) {
+            --level;
+        }
+    } else if (frames_under >= frames_to_step) {
+        // back up the way down, the levels were only given up at the lowest render scale
+        if (level + 1 < levels_count) {
+            ++level;
+        } else if (render_scale_enabled && render_scale < 1.0f) {
+            render_scale = std::min(render_scale + render_scale_step, 1.0f);
+        }
+    } else {
+        return false;
+    }
+    frames_over = 0;
+    frames_under = 0;
+    const bool stepped = level != previous_level || render_scale != previous_render_scale;
+    if (stepped) {
+        frames_settling = frames_to_settle;
+    }
+    return stepped;
+}
+
+void ssr_governor::reset() {
+    level = levels_count - 1;
+    render_scale = 1.0f;
+    measured_ms = 0.0f;
+    frames_over = 0;
+    frames_under = 0;
+    frames_settling = 0;
+}
+
+ssr_governor::status ssr_governor::report() const {
+    return {budget_ms, measured_ms, level, render_scale};
+}
@@ -0,0 +1,47 @@
+#ifndef SSR_GOVERNOR_HPP
+#define SSR_GOVERNOR_HPP
+
+#include <cstddef>
+
+// holds the raytrace gpu time of a frame near budget_ms, trading the render scale first and then
+// a quality level, levels_count of them from the lowest allowed quality at 0 to the highest
+// the time has to stay out of the hysteresis band around the budget for frames_to_step frames
+// before anything changes, and the frames still in flight after a change are not held against it
+struct ssr_governor {
+    static constexpr size_t levels_count = 8;
+
+    // steps only while enabled, set before ssr_compositor::init, which turns profiling on for it, or later
+    // through ssr_compositor::set_governor_enabled
+    bool enabled = false;
+    float budget_ms = 2.0f;
+    // fraction of the budget the time may stray either way without a step
+    float hysteresis = 0.15f;
+    unsigned frames_to_step = 8;
+    // frames between a step and the first time measured with it, the timestamp queries lag behind
+    unsigned frames_to_settle = 4;
+    float render_scale_min = 0.5f;
+    float render_scale_step = 0.125f;
+
+    struct status {
+        float budget_ms;
+        // raytrace gpu time of the last frame measured, summed over the viewports it traced
+        float measured_ms;
+        size_t level;
+        float render_scale;
+    };
+
+    size_t level = levels_count - 1;
+    float render_scale = 1.0f;
+    float measured_ms = 0.0f;
+    unsigned frames_over = 0;
+    unsigned frames_under = 0;
+    unsigned frames_settling = 0;
+
+    // feeds the raytrace time of the last frame, true when the level or the render scale changed
+    // render_scale_enabled is false when the pipelines can't trace a part of their targets
+    bool update(float raytrace_ms, bool render_scale_enabled);
+    void reset();
+    status report() const;
+};
+
+#endif
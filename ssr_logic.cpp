@@ -1,73 +1,269 @@
 #include "ssr_logic.hpp"
 #include <OgreMaterial.h>
 #include <OgreTechnique.h>
+#include <OgreCompositor.h>
 #include <OgreCompositorChain.h>
+#include <OgreViewport.h>
+#include <OgreGpuProgramManager.h>
+#include <OgreRoot.h>
+#include <OgreRenderSystem.h>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 const std::string ssr_logic::name = "ssr";
+const std::string ssr_logic::constants_name = "ssr/constants";
+const std::string ssr_logic::scissor_reset_type = "ssr/scissor_reset";
+
+static_assert(sizeof(Ogre::Real) == sizeof(float), "the shared constants are written as float matrices");
+
+static const std::array<const char *, 4> constants_matrix_names{
+    "raytrace_projection_matrix",
+    "raytrace_i_projection_matrix",
+    "raytrace_i_view_matrix",
+    "raytrace_previous_view_projection_matrix",
+};
+
+// xy the render scale of this frame, zw the one the history was accumulated at
+static const char *constants_render_scale_name = "raytrace_render_scale";
+// frames the raytrace of the instance ran, seeds the rays it samples so they differ every frame
+static const char *constants_frame_name = "raytrace_frame";
+
+static Ogre::GpuSharedParametersPtr ssr_logic_constants() {
+    auto &program_manager = Ogre::GpuProgramManager::getSingleton();
+    if (program_manager.getAvailableSharedParameters().count(ssr_logic::constants_name) != 0) {
+        return program_manager.getSharedParameters(ssr_logic::constants_name);
+    }
+    Ogre::GpuSharedParametersPtr constants = program_manager.createSharedParameters(ssr_logic::constants_name);
+    for (const char *matrix_name : constants_matrix_names) {
+        constants->addConstantDefinition(matrix_name, Ogre::GCT_MATRIX_4X4);
+    }
+    constants->addConstantDefinition(constants_render_scale_name, Ogre::GCT_FLOAT4);
+    constants->addConstantDefinition(constants_frame_name, Ogre::GCT_INT1);
+    return constants;
+}
+
+void ssr_logic::attach_constants(Ogre::GpuProgramParameters &parameters) {
+    if (!parameters.isUsingSharedParameters(constants_name)) {
+        parameters.addSharedParameters(ssr_logic_constants());
+    }
+}
+
+float ssr_logic::render_scale(const Ogre::Viewport &viewport) const {
+    auto it = render_scales.find(&viewport);
+    return it == render_scales.end() ? 1.0f : it->second;
+}
 
 struct ssr_instance : public Ogre::CompositorInstance::Listener {
+    const ssr_logic &logic;
     std::reference_wrapper<Ogre::Viewport> viewport;
     uint16_t target_width;
     uint16_t target_height;
 
-    static constexpr std::string_view raytrace_material_name = "ssr/output_raytrace";
+    // shared block and the physical indices of its matrices, resolved once
+    Ogre::GpuSharedParametersPtr constants;
+    size_t constants_projection_matrix;
+    size_t constants_i_projection_matrix;
+    size_t constants_i_view_matrix;
+    size_t constants_previous_view_projection_matrix;
+    size_t constants_render_scale;
+    size_t constants_frame;
+    // instance whose camera the shared block holds, any other rewrites it before its passes
+    static inline const ssr_instance *constants_owner = nullptr;
+
+    // camera the inverses were computed from, recomputed only when it moves
+    Ogre::Matrix4 view_matrix;
+    Ogre::Matrix4 projection_matrix;
+    Ogre::Matrix4 i_view_matrix;
+    Ogre::Matrix4 i_projection_matrix;
+    bool camera_valid;
+
+    // view projection the temporal pass reprojects into, advanced once per frame after it renders
+    Ogre::Matrix4 previous_view_projection_matrix;
+    bool previous_view_projection_valid;
 
-    ssr_instance(Ogre::Viewport &viewport) : viewport{viewport}, target_width{0}, target_height{0} { }
+    // render scale of the frame being traced and of the history, the block holds render_scale_constant
+    float render_scale;
+    float history_render_scale;
+    Ogre::Vector4 render_scale_constant;
+    // whether the compositor of the instance follows the render scale
+    bool render_scaled;
+
+    uint32_t frame;
+
+    ssr_instance(const ssr_logic &logic, Ogre::Viewport &viewport, bool render_scaled) :
+        logic{logic},
+        viewport{viewport},
+        target_width{0},
+        target_height{0},
+        constants{ssr_logic_constants()},
+        constants_projection_matrix{constants->getConstantDefinition(constants_matrix_names[0]).physicalIndex},
+        constants_i_projection_matrix{constants->getConstantDefinition(constants_matrix_names[1]).physicalIndex},
+        constants_i_view_matrix{constants->getConstantDefinition(constants_matrix_names[2]).physicalIndex},
+        constants_previous_view_projection_matrix{constants->getConstantDefinition(constants_matrix_names[3]).physicalIndex},
+        constants_render_scale{constants->getConstantDefinition(constants_render_scale_name).physicalIndex},
+        constants_frame{constants->getConstantDefinition(constants_frame_name).physicalIndex},
+        view_matrix{Ogre::Matrix4::IDENTITY},
+        projection_matrix{Ogre::Matrix4::IDENTITY},
+        i_view_matrix{Ogre::Matrix4::IDENTITY},
+        i_projection_matrix{Ogre::Matrix4::IDENTITY},
+        camera_valid{false},
+        previous_view_projection_matrix{Ogre::Matrix4::IDENTITY},
+        previous_view_projection_valid{false},
+        render_scale{1.0f},
+        history_render_scale{1.0f},
+        render_scale_constant{1.0f, 1.0f, 1.0f, 1.0f},
+        render_scaled{render_scaled},
+        frame{0} { }
+    ~ssr_instance() {
+        if (constants_owner == this) {
+            constants_owner = nullptr;
+        }
+    }
 
     void notify_viewport_size(uint16_t width, uint16_t height) {
         target_width = width;
         target_height = height;
     }
 
+    void write_constant(size_t physical_index, const Ogre::Matrix4 &matrix) {
+        std::memcpy(constants->getFloatPointer(physical_index), matrix[0], sizeof(float) * 16);
+    }
+
+    void update_camera_constants() {
+        const auto &camera = *viewport.get().getCamera();
+        const Ogre::Matrix4 view = camera.getViewMatrix();
+        const Ogre::Matrix4 &projection = camera.getProjectionMatrix();
+        const bool camera_changed = !camera_valid || view != view_matrix || projection != projection_matrix;
+        if (camera_changed) {
+            view_matrix = view;
+            projection_matrix = projection;
+            i_view_matrix = view.inverse();
+            i_projection_matrix = projection.inverse();
+            camera_valid = true;
+        }
+        const Ogre::Vector4 scale{render_scale, render_scale, history_render_scale, history_render_scale};
+        const bool scale_changed = scale != render_scale_constant;
+        if (!camera_changed && !scale_changed && constants_owner == this) {
+            return;
+        }
+        render_scale_constant = scale;
+        write_constant(constants_projection_matrix, projection_matrix);
+        write_constant(constants_i_projection_matrix, i_projection_matrix);
+        write_constant(constants_i_view_matrix, i_view_matrix);
+        std::memcpy(constants->getFloatPointer(constants_render_scale), render_scale_constant.ptr(), sizeof(float) * 4);
+        constants->_markDirty();
+        constants_owner = this;
+    }
+    void update_raytrace_constants() {
+        update_camera_constants();
+        // wraps around, the shaders only hash it
+        ++frame;
+        std::memcpy(constants->getIntPointer(constants_frame), &frame, sizeof(frame));
+        constants->_markDirty();
+    }
+    void update_temporal_constants() {
+        update_camera_constants();
+        if (!previous_view_projection_valid) {
+            previous_view_projection_matrix = projection_matrix * view_matrix;
+            previous_view_projection_valid = true;
+        }
+        write_constant(constants_previous_view_projection_matrix, previous_view_projection_matrix);
+        constants->_markDirty();
+    }
+
+    void set_gbuffer_clear_constants(Ogre::MaterialPtr &mat) {
+        auto fragment_parameters =
+            mat->getTechnique(0)->getPass(0)->getFragmentProgramParameters();
+        fragment_parameters->setNamedConstant(
+            "background_colour",
+            viewport.get().getBackgroundColour()
+        );
+    }
+
+    // limits the quad to the texels traced at this frame's scale, a scissor_reset_type pass follows it
+    void scissor_render_scale() {
+        Ogre::RenderSystem &render_system = *Ogre::Root::getSingleton().getRenderSystem();
+        const Ogre::Viewport *target_viewport = render_system._getViewport();
+        if (!render_scaled || render_scale >= 1.0f || target_viewport == nullptr) {
+            return;
+        }
+        const int width = target_viewport->getActualWidth();
+        const int height = target_viewport->getActualHeight();
+        const long right = std::min(long(std::ceil(float(width) * render_scale)), long(width));
+        const long bottom = std::min(long(std::ceil(float(height) * render_scale)), long(height));
+        const long left = target_viewport->getActualLeft();
+        const long top = target_viewport->getActualTop();
+        render_system.setScissorTest(true, Ogre::Rect(left, top, left + right, top + bottom));
+    }
+
     void notifyMaterialSetup(Ogre::uint32 pass_id, Ogre::MaterialPtr &mat) override {
-        (void)pass_id;
-        if (mat->getName().ends_with(raytrace_material_name)) {
-            auto fragment_parameters =
-                mat->getTechnique(0)->getPass(0)->getFragmentProgramParameters();
-            const auto &camera = *viewport.get().getCamera();
-
-            fragment_parameters->setNamedConstant(
-                "raytrace_projection_matrix",
-                camera.getProjectionMatrix()
-            );
-            fragment_parameters->setNamedConstant(
-                "raytrace_i_projection_matrix",
-                camera.getProjectionMatrix().inverse()
-            );
-            fragment_parameters->setNamedConstant(
-                "raytrace_i_view_matrix",
-                camera.getViewMatrix().inverse()
-            );
+        if (pass_id == ssr_logic::pass_id_gbuffer_clear) {
+            set_gbuffer_clear_constants(mat);
         }
     }
     void notifyMaterialRender(Ogre::uint32 pass_id, Ogre::MaterialPtr &mat) override {
-        (void)pass_id;
-        if (mat->getName().ends_with(raytrace_material_name)) {
-            auto fragment_parameters =
-                mat->getTechnique(0)->getPass(0)->getFragmentProgramParameters();
-            const auto &camera = *viewport.get().getCamera();
-
-            fragment_parameters->setNamedConstant(
-                "raytrace_projection_matrix",
-                camera.getProjectionMatrix()
-            );
-            fragment_parameters->setNamedConstant(
-                "raytrace_i_projection_matrix",
-                camera.getProjectionMatrix().inverse()
-            );
-            fragment_parameters->setNamedConstant(
-                "raytrace_i_view_matrix",
-                camera.getViewMatrix().inverse()
-            );
+        switch (pass_id) {
+        case ssr_logic::pass_id_raytrace:
+            // the passes after the raytrace this frame filter what it traced at this scale
+            render_scale = logic.render_scale(viewport);
+            update_raytrace_constants();
+            scissor_render_scale();
+            break;
+        case ssr_logic::pass_id_tiles:
+            update_camera_constants();
+            break;
+        case ssr_logic::pass_id_resolve:
+            update_camera_constants();
+            scissor_render_scale();
+            break;
+        case ssr_logic::pass_id_denoise:
+            scissor_render_scale();
+            break;
+        case ssr_logic::pass_id_temporal:
+            update_temporal_constants();
+            scissor_render_scale();
+            previous_view_projection_matrix = projection_matrix * view_matrix;
+            history_render_scale = render_scale;
+            break;
+        case ssr_logic::pass_id_gbuffer_clear:
+            set_gbuffer_clear_constants(mat);
+            break;
         }
     }
+    void notifyResourcesCreated(bool for_resize_only) override {
+        (void)for_resize_only;
+        // the targets follow the viewport size, recreated whenever it changes
+        notify_viewport_size(viewport.get().getActualWidth(), viewport.get().getActualHeight());
+        // the history was cleared with the new targets, there is nothing to reproject from
+        previous_view_projection_valid = false;
+        history_render_scale = render_scale;
+    }
 };
 
 Ogre::CompositorInstance::Listener *ssr_logic::createListener(Ogre::CompositorInstance *instance) {
     Ogre::Viewport &viewport = *instance->getChain()->getViewport();
-    ssr_instance* ssr = new ssr_instance{viewport};
+    const bool render_scaled = render_scaled_compositors.count(instance->getCompositor()->getName()) != 0;
+    ssr_instance* ssr = new ssr_instance{*this, viewport, render_scaled};
     ssr->notify_viewport_size(viewport.getActualWidth(), viewport.getActualHeight());
     return ssr;
 }
+
+struct ssr_logic_scissor_reset : public Ogre::CompositorInstance::RenderSystemOperation {
+    void execute(Ogre::SceneManager *scene_manager, Ogre::RenderSystem *render_system) override {
+        (void)scene_manager;
+        render_system->setScissorTest(false);
+    }
+};
+
+Ogre::CompositorInstance::RenderSystemOperation *ssr_logic::createOperation(
+    Ogre::CompositorInstance *instance,
+    const Ogre::CompositionPass *pass
+) {
+    (void)instance;
+    (void)pass;
+    return new ssr_logic_scissor_reset{};
+}
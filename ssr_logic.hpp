@@ -4,13 +4,41 @@
 #include <OgrePrerequisites.h>
 #include <OgreCompositorLogic.h>
 #include <OgreCompositorInstance.h>
+#include <OgreCustomCompositionPass.h>
+#include <OgreGpuProgramParams.h>
 
 #include "ListenerFactoryLogic.h"
 #include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
-// TODO: use it to edit values at runtime
-struct ssr_logic : public ListenerFactoryLogic {
+struct ssr_logic : public ListenerFactoryLogic, public Ogre::CustomCompositionPass {
     static const std::string name;
+    // compositor pass identifiers the instance listeners dispatch on
+    static constexpr Ogre::uint32 pass_id_raytrace = 1;
+    static constexpr Ogre::uint32 pass_id_temporal = 2;
+    static constexpr Ogre::uint32 pass_id_gbuffer_clear = 3;
+    static constexpr Ogre::uint32 pass_id_tiles = 4;
+    static constexpr Ogre::uint32 pass_id_resolve = 5;
+    static constexpr Ogre::uint32 pass_id_denoise = 6;
+
+    // camera matrices shared by every pass reading them, written once per instance and frame
+    static const std::string constants_name;
+    static void attach_constants(Ogre::GpuProgramParameters &parameters);
+
+    // fraction of the reflection targets each viewport traces this frame, latched by its raytrace pass
+    // see ssr_compositor::set_render_scale, viewports left out trace all of them
+    std::unordered_map<const Ogre::Viewport *, float> render_scales{};
+    float render_scale(const Ogre::Viewport &viewport) const;
+    // compositors whose reflection passes trace and filter at the render scale, the others ignore it
+    std::unordered_set<std::string> render_scaled_compositors{};
+
+    // custom pass following every render scaled pass, turns the scissor of its quad off again
+    static const std::string scissor_reset_type;
+    Ogre::CompositorInstance::RenderSystemOperation *createOperation(
+        Ogre::CompositorInstance *instance,
+        const Ogre::CompositionPass *pass
+    ) override;
 protected:
     Ogre::CompositorInstance::Listener* createListener(Ogre::CompositorInstance* instance) override;
 };
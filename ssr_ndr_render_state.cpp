@@ -0,0 +1,91 @@
+#include "ssr_ndr_render_state.hpp"
+#include <OgreRTShaderSystem.h>
+
+const Ogre::String ssr_ndr_render_state::type = "ssr_normal_depth_rough";
+
+static const char *ndr_library_name = "SSRLib_NormalDepthRough";
+static const char *ndr_function_name = "SSR_NormalDepthRough";
+
+static ssr_ndr_render_state_factory ndr_render_state_factory{};
+
+
+const Ogre::String &ssr_ndr_render_state::getType() const {
+    return type;
+}
+int ssr_ndr_render_state::getExecutionOrder() const {
+    return Ogre::RTShader::FFP_POST_PROCESS;
+}
+void ssr_ndr_render_state::copyFrom(const Ogre::RTShader::SubRenderState &rhs) {
+    (void)rhs;
+}
+
+bool ssr_ndr_render_state::createCpuSubPrograms(Ogre::RTShader::ProgramSet *program_set) {
+    using namespace Ogre::RTShader;
+    Program *vs_program = program_set->getCpuProgram(Ogre::GPT_VERTEX_PROGRAM);
+    Program *ps_program = program_set->getCpuProgram(Ogre::GPT_FRAGMENT_PROGRAM);
+    Function *vs_main = vs_program->getMain();
+    Function *ps_main = ps_program->getMain();
+
+    vs_program->addDependency(FFP_LIB_TRANSFORM);
+    ps_program->addDependency(ndr_library_name);
+
+    // same view space normal as ssr_output_normal_depth_rough_vp.glsl
+    ParameterPtr vs_in_normal = vs_main->resolveInputParameter(Parameter::SPC_NORMAL_OBJECT_SPACE);
+    ParameterPtr vs_out_normal = vs_main->resolveOutputParameter(Parameter::SPC_NORMAL_VIEW_SPACE);
+    UniformParameterPtr normal_matrix = vs_program->resolveParameter(Ogre::GpuProgramParameters::ACT_NORMAL_MATRIX);
+    vs_main->getStage(FFP_VS_POST_PROCESS).callFunction(
+        FFP_FUNC_TRANSFORM,
+        normal_matrix,
+        vs_in_normal,
+        vs_out_normal
+    );
+
+    // clip space position interpolated for the same depth as the separate pass, not gl_FragCoord.z
+    ParameterPtr vs_position_cs = vs_main->resolveOutputParameter(Parameter::SPC_POSITION_PROJECTIVE_SPACE);
+    ParameterPtr vs_out_position_cs = vs_main->resolveOutputParameter(
+        Parameter::Content(Parameter::SPC_CUSTOM_CONTENT_BEGIN),
+        Ogre::GCT_FLOAT4
+    );
+    vs_main->getStage(FFP_VS_POST_PROCESS).assign(vs_position_cs, vs_out_position_cs);
+
+    // the scene colour keeps output 0, normal_depth_rough goes to output 1
+    ParameterPtr ps_in_normal = ps_main->resolveInputParameter(vs_out_normal);
+    ParameterPtr ps_in_position_cs = ps_main->resolveInputParameter(vs_out_position_cs);
+    UniformParameterPtr specular = ps_program->resolveParameter(Ogre::GpuProgramParameters::ACT_SURFACE_SPECULAR_COLOUR);
+    UniformParameterPtr shininess = ps_program->resolveParameter(Ogre::GpuProgramParameters::ACT_SURFACE_SHININESS);
+    ParameterPtr ps_out_ndr = ps_main->resolveOutputParameter(Parameter::SPC_COLOR_SPECULAR);
+    ps_main->getStage(FFP_PS_POST_PROCESS).callFunction(
+        ndr_function_name,
+        {In(ps_in_normal), In(ps_in_position_cs), In(specular), In(shininess), Out(ps_out_ndr)}
+    );
+    return true;
+}
+
+
+const Ogre::String &ssr_ndr_render_state_factory::getType() const {
+    return ssr_ndr_render_state::type;
+}
+Ogre::RTShader::SubRenderState *ssr_ndr_render_state_factory::createInstanceImpl() {
+    return new ssr_ndr_render_state{};
+}
+
+
+void ssr_ndr_render_state_attach(Ogre::RTShader::ShaderGenerator &generator, const Ogre::String &scheme_name) {
+    if (!generator.getSubRenderStateFactory(ssr_ndr_render_state::type)) {
+        generator.addSubRenderStateFactory(&ndr_render_state_factory);
+    }
+    Ogre::RTShader::RenderState *render_state = generator.getRenderState(scheme_name);
+    render_state->addTemplateSubRenderState(generator.createSubRenderState(ssr_ndr_render_state::type));
+    generator.invalidateScheme(scheme_name);
+}
+void ssr_ndr_render_state_detach(Ogre::RTShader::ShaderGenerator &generator, const Ogre::String &scheme_name) {
+    Ogre::RTShader::RenderState *render_state = generator.getRenderState(scheme_name);
+    for (Ogre::RTShader::SubRenderState *sub_render_state : render_state->getSubRenderStates()) {
+        if (sub_render_state->getType() == ssr_ndr_render_state::type) {
+            render_state->removeSubRenderState(sub_render_state);
+            break;
+        }
+    }
+    generator.invalidateScheme(scheme_name);
+    generator.removeSubRenderStateFactory(&ndr_render_state_factory);
+}
@@ -0,0 +1,27 @@
+#ifndef SSR_NDR_RENDER_STATE_HPP
+#define SSR_NDR_RENDER_STATE_HPP
+
+#include <OgreShaderSubRenderState.h>
+#include <OgreShaderGenerator.h>
+
+// adds the unpacked normal_depth_rough layout as a second colour output to the shaders the RTSS
+// generates, so a single render_scene fills the scene colour and normal_depth_rough together
+struct ssr_ndr_render_state : public Ogre::RTShader::SubRenderState {
+    static const Ogre::String type;
+
+    const Ogre::String &getType() const override;
+    int getExecutionOrder() const override;
+    void copyFrom(const Ogre::RTShader::SubRenderState &rhs) override;
+    bool createCpuSubPrograms(Ogre::RTShader::ProgramSet *program_set) override;
+};
+
+struct ssr_ndr_render_state_factory : public Ogre::RTShader::SubRenderStateFactory {
+    const Ogre::String &getType() const override;
+protected:
+    Ogre::RTShader::SubRenderState *createInstanceImpl() override;
+};
+
+void ssr_ndr_render_state_attach(Ogre::RTShader::ShaderGenerator &generator, const Ogre::String &scheme_name);
+void ssr_ndr_render_state_detach(Ogre::RTShader::ShaderGenerator &generator, const Ogre::String &scheme_name);
+
+#endif
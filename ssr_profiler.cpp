@@ -0,0 +1,280 @@
+#include "ssr_profiler.hpp"
+#include <OgreCompositionTargetPass.h>
+#include <OgreCompositionPass.h>
+#include <OgreCompositorInstance.h>
+#include <OgreCompositor.h>
+#include <OgreRenderSystem.h>
+#include <OgreRoot.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+const std::string ssr_profiler::custom_type_prefix = "ssr/timestamp/";
+
+#ifdef _WIN32
+#define SSR_PROFILER_GL_APIENTRY __stdcall
+#else
+#define SSR_PROFILER_GL_APIENTRY
+#endif
+
+// looks an entry point up through the loader of the OpenGL library the render system already loaded, it
+// resolves against whichever context that made current, and never loads a library of its own
+#if defined(__APPLE__)
+static void *ssr_profiler_gl_proc(const char *name) {
+    // the OpenGL framework exports every core entry point itself
+    return dlsym(RTLD_DEFAULT, name);
+}
+#else
+using ssr_profiler_gl_loader = void *(SSR_PROFILER_GL_APIENTRY *)(const char *);
+
+static ssr_profiler_gl_loader ssr_profiler_gl_loader_get() {
+#ifdef _WIN32
+    HMODULE library = GetModuleHandleA("opengl32.dll");
+    return library != nullptr
+        ? reinterpret_cast<ssr_profiler_gl_loader>(GetProcAddress(library, "wglGetProcAddress"))
+        : nullptr;
+#else
+    const std::array<std::pair<const char *, const char *>, 2> loaders{{
+        {"libGL.so.1", "glXGetProcAddressARB"},
+        {"libEGL.so.1", "eglGetProcAddress"},
+    }};
+    for (const auto &[library_name, loader_name] : loaders) {
+        if (void *library = dlopen(library_name, RTLD_LAZY | RTLD_NOLOAD)) {
+            return reinterpret_cast<ssr_profiler_gl_loader>(dlsym(library, loader_name));
+        }
+    }
+    return nullptr;
+#endif
+}
+
+static void *ssr_profiler_gl_proc(const char *name) {
+    static const ssr_profiler_gl_loader loader = ssr_profiler_gl_loader_get();
+    return loader != nullptr ? loader(name) : nullptr;
+}
+#endif
+
+// the few timer query entry points, resolved from the context the OpenGL 3+ render system made current
+struct ssr_profiler_gl {
+    static constexpr unsigned timestamp = 0x8E28;
+    static constexpr unsigned query_result = 0x8866;
+    static constexpr unsigned query_result_available = 0x8867;
+
+    void (SSR_PROFILER_GL_APIENTRY *gen_queries)(int, unsigned *);
+    void (SSR_PROFILER_GL_APIENTRY *delete_queries)(int, const unsigned *);
+    void (SSR_PROFILER_GL_APIENTRY *query_counter)(unsigned, unsigned);
+    void (SSR_PROFILER_GL_APIENTRY *get_query_object_iv)(unsigned, unsigned, int *);
+    void (SSR_PROFILER_GL_APIENTRY *get_query_object_ui64v)(unsigned, unsigned, uint64_t *);
+    bool available;
+};
+
+static const ssr_profiler_gl &ssr_profiler_gl_get() {
+    static const ssr_profiler_gl gl = [] {
+        ssr_profiler_gl result{};
+        const Ogre::RenderSystem *render_system = Ogre::Root::getSingleton().getRenderSystem();
+        if (render_system == nullptr || render_system->getName().find("OpenGL 3+") == std::string::npos) {
+            return result;
+        }
+        result.gen_queries = reinterpret_cast<decltype(result.gen_queries)>(ssr_profiler_gl_proc("glGenQueries"));
+        result.delete_queries = reinterpret_cast<decltype(result.delete_queries)>(ssr_profiler_gl_proc("glDeleteQueries"));
+        result.query_counter = reinterpret_cast<decltype(result.query_counter)>(ssr_profiler_gl_proc("glQueryCounter"));
+        result.get_query_object_iv = reinterpret_cast<decltype(result.get_query_object_iv)>(
+            ssr_profiler_gl_proc("glGetQueryObjectiv")
+        );
+        result.get_query_object_ui64v = reinterpret_cast<decltype(result.get_query_object_ui64v)>(
+            ssr_profiler_gl_proc("glGetQueryObjectui64v")
+        );
+        result.available = result.gen_queries
+            && result.delete_queries
+            && result.query_counter
+            && result.get_query_object_iv
+            && result.get_query_object_ui64v;
+        return result;
+    }();
+    return gl;
+}
+
+static void ssr_profiler_push(std::array<float, ssr_profiler::window_size> &window, size_t &samples, float value) {
+    window[samples % ssr_profiler::window_size] = value;
+    ++samples;
+}
+
+static ssr_profiler::stats ssr_profiler_stats(const std::array<float, ssr_profiler::window_size> &window, size_t samples) {
+    std::vector<float> sorted(window.begin(), window.begin() + std::min(samples, ssr_profiler::window_size));
+    if (sorted.empty()) {
+        return {0.0f, 0.0f, 0.0f};
+    }
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0.0f;
+    for (const float value : sorted) {
+        sum += value;
+    }
+    const size_t p99 = std::min(sorted.size() - 1, (sorted.size() * 99) / 100);
+    return {sorted.front(), sum / float(sorted.size()), sorted[p99]};
+}
+
+struct ssr_profiler_operation : public Ogre::CompositorInstance::RenderSystemOperation {
+    ssr_profiler &profiler;
+    ssr_profiler::stage &stage;
+    bool begin;
+
+    ssr_profiler_operation(ssr_profiler &profiler, ssr_profiler::stage &stage, bool begin) :
+        profiler{profiler},
+        stage{stage},
+        begin{begin} { }
+
+    void execute(Ogre::SceneManager *sm, Ogre::RenderSystem *rs) override {
+        (void)sm;
+        (void)rs;
+        const ssr_profiler_gl &gl = ssr_profiler_gl_get();
+        const size_t slot = stage.queries_frame % ssr_profiler::queries_latency;
+        if (begin) {
+            stage.cpu_begin = std::chrono::steady_clock::now();
+            if (gl.available) {
+                if (stage.queries[slot][0] == 0) {
+                    gl.gen_queries(2, stage.queries[slot].data());
+                }
+                // the pair issued queries_latency frames ago is usually done by now, it is dropped otherwise
+                if (stage.queries_pending[slot]) {
+                    int done = 0;
+                    gl.get_query_object_iv(stage.queries[slot][1], ssr_profiler_gl::query_result_available, &done);
+                    if (done != 0) {
+                        uint64_t begin_ns = 0;
+                        uint64_t end_ns = 0;
+                        gl.get_query_object_ui64v(stage.queries[slot][0], ssr_profiler_gl::query_result, &begin_ns);
+                        gl.get_query_object_ui64v(stage.queries[slot][1], ssr_profiler_gl::query_result, &end_ns);
+                        ssr_profiler_push(stage.gpu_ms, stage.gpu_samples, float(end_ns - begin_ns) * 1e-6f);
+                    }
+                    stage.queries_pending[slot] = false;
+                }
+                gl.query_counter(stage.queries[slot][0], ssr_profiler_gl::timestamp);
+            }
+            return;
+        }
+
+        const auto cpu_end = std::chrono::steady_clock::now();
+        ssr_profiler_push(
+            stage.cpu_ms,
+            stage.cpu_samples,
+            std::chrono::duration<float, std::milli>(cpu_end - stage.cpu_begin).count()
+        );
+        if (gl.available) {
+            gl.query_counter(stage.queries[slot][1], ssr_profiler_gl::timestamp);
+            stage.queries_pending[slot] = true;
+        }
+        ++stage.queries_frame;
+        stage.last_frame = profiler.frame;
+    }
+};
+
+ssr_profiler::stage &ssr_profiler::stage_named(const std::string &name) {
+    for (const auto &existing : stages) {
+        if (existing->name == name) {
+            return *existing;
+        }
+    }
+    stages.push_back(std::make_unique<stage>());
+    stages.back()->name = name;
+    return *stages.back();
+}
+
+void ssr_profiler::attach(Ogre::CompositorManager &composer, const Ogre::CompositionTechnique &technique) {
+    auto attach_target_pass = [&](const Ogre::CompositionTargetPass &target_pass) {
+        for (const Ogre::CompositionPass *pass : target_pass.getPasses()) {
+            const bool timestamp = pass->getType() == Ogre::CompositionPass::PT_RENDERCUSTOM
+                && pass->getCustomType().starts_with(custom_type_prefix);
+            if (timestamp) {
+                composer.registerCustomCompositionPass(pass->getCustomType(), this);
+            }
+        }
+    };
+    for (const Ogre::CompositionTargetPass *target_pass : technique.getTargetPasses()) {
+        attach_target_pass(*target_pass);
+    }
+    attach_target_pass(*technique.getOutputTargetPass());
+}
+
+void ssr_profiler::detach(Ogre::CompositorManager &composer) {
+    (void)composer;
+    // the custom pass types stay registered, the compositors using them are gone with the pipelines
+    const ssr_profiler_gl &gl = ssr_profiler_gl_get();
+    for (const auto &stage : stages) {
+        for (const auto &queries : stage->queries) {
+            if (gl.available && queries[0] != 0) {
+                gl.delete_queries(2, queries.data());
+            }
+        }
+    }
+    stages.clear();
+    close_csv();
+}
+
+void ssr_profiler::frame_ended() {
+    if (csv.is_open()) {
+        for (const auto &stage : stages) {
+            if (stage->last_frame != frame || stage->cpu_samples == 0) {
+                continue;
+            }
+            const float cpu_ms = stage->cpu_ms[(stage->cpu_samples - 1) % window_size];
+            const float gpu_ms = stage->gpu_samples == 0 ? 0.0f : stage->gpu_ms[(stage->gpu_samples - 1) % window_size];
+            csv << frame << ',' << stage->name << ',' << gpu_ms << ',' << cpu_ms << '\n';
+        }
+    }
+    ++frame;
+}
+
+void ssr_profiler::reset_samples() {
+    for (const auto &stage : stages) {
+        stage->gpu_samples = 0;
+        stage->cpu_samples = 0;
+    }
+}
+
+bool ssr_profiler::open_csv(const std::string &path) {
+    close_csv();
+    csv.open(path, std::ios::out | std::ios::trunc);
+    if (!csv.is_open()) {
+        return false;
+    }
+    csv << "frame,stage,gpu_ms,cpu_ms\n";
+    return true;
+}
+void ssr_profiler::close_csv() {
+    if (csv.is_open()) {
+        csv.close();
+    }
+}
+
+std::vector<ssr_profiler::report> ssr_profiler::reports() const {
+    std::vector<report> result{};
+    for (const auto &stage : stages) {
+        // frame_ended already advanced past the frame the stages were sampled in
+        if (stage->last_frame + 1 != frame) {
+            continue;
+        }
+        result.push_back({
+            stage->name,
+            ssr_profiler_stats(stage->gpu_ms, stage->gpu_samples),
+            ssr_profiler_stats(stage->cpu_ms, stage->cpu_samples),
+            stage->gpu_samples != 0,
+        });
+    }
+    return result;
+}
+
+Ogre::CompositorInstance::RenderSystemOperation *ssr_profiler::createOperation(
+    Ogre::CompositorInstance *instance,
+    const Ogre::CompositionPass *pass
+) {
+    const std::string label = pass->getCustomType().substr(custom_type_prefix.size());
+    stage &timed = stage_named(instance->getCompositor()->getName() + "/" + label);
+    return new ssr_profiler_operation{*this, timed, pass->getIdentifier() == timestamp_begin};
+}
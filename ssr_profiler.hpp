@@ -0,0 +1,82 @@
+#ifndef SSR_PROFILER_HPP
+#define SSR_PROFILER_HPP
+
+#include <OgreCompositorManager.h>
+#include <OgreCustomCompositionPass.h>
+#include <OgreCompositionTechnique.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// gpu and cpu time of the ssr target passes, the pipelines bracket each target pass they want timed
+// with two custom passes of type custom_type_prefix + stage label, the first identified as
+// timestamp_begin and the last as timestamp_end
+// gpu times come from timestamp queries read back queries_latency frames later, only under the
+// OpenGL 3+ render system, cpu times are the submission time between both custom passes
+struct ssr_profiler : public Ogre::CustomCompositionPass {
+    static const std::string custom_type_prefix;
+    static constexpr Ogre::uint32 timestamp_begin = 0;
+    static constexpr Ogre::uint32 timestamp_end = 1;
+    static constexpr size_t window_size = 128;
+    static constexpr size_t queries_latency = 4;
+
+    struct stats {
+        float min_ms;
+        float avg_ms;
+        float p99_ms;
+    };
+    struct stage {
+        // compositor name and stage label
+        std::string name;
+        // rolling windows of the last window_size samples
+        std::array<float, window_size> gpu_ms{};
+        std::array<float, window_size> cpu_ms{};
+        size_t gpu_samples = 0;
+        size_t cpu_samples = 0;
+        // begin and end timestamp query pairs in flight
+        std::array<std::array<unsigned, 2>, queries_latency> queries{};
+        std::array<bool, queries_latency> queries_pending{};
+        size_t queries_frame = 0;
+        std::chrono::steady_clock::time_point cpu_begin{};
+        uint64_t last_frame = 0;
+    };
+    struct report {
+        std::string name;
+        stats gpu;
+        stats cpu;
+        bool gpu_valid;
+    };
+
+    // owned here so the operations the compositor instances hold keep stable pointers
+    std::vector<std::unique_ptr<stage>> stages{};
+    uint64_t frame = 0;
+    std::ofstream csv{};
+
+    // registers the custom pass types the technique uses with the compositor manager
+    void attach(Ogre::CompositorManager &composer, const Ogre::CompositionTechnique &technique);
+    void detach(Ogre::CompositorManager &composer);
+
+    // advances the frame and streams the samples of the frame to the csv file when open
+    void frame_ended();
+    // drops the rolling windows, the queries in flight are still read back
+    void reset_samples();
+    bool open_csv(const std::string &path);
+    void close_csv();
+
+    // stages sampled during the last frame
+    std::vector<report> reports() const;
+
+    Ogre::CompositorInstance::RenderSystemOperation *createOperation(
+        Ogre::CompositorInstance *instance,
+        const Ogre::CompositionPass *pass
+    ) override;
+
+    stage &stage_named(const std::string &name);
+};
+
+#endif
@@ -0,0 +1,656 @@
+#include "ssr_capture.hpp"
+#include "ssr_compositor.hpp"
+#include "ssr_cpu.hpp"
+
+#include <OgreApplicationContext.h>
+#include <OgreRoot.h>
+#include <OgreSceneManager.h>
+#include <OgreCamera.h>
+#include <OgreTechnique.h>
+#include <OgreTextureManager.h>
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreRenderTexture.h>
+#include <OgreCompositorManager.h>
+#include <OgreCompositionTechnique.h>
+#include <OgreCompositionTargetPass.h>
+#include <OgreCompositionPass.h>
+#include <OgreGpuProgramManager.h>
+#include <OgreViewport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// traces every capture of a directory with ssr/output_raytrace offscreen and prints the gpu times of the
+// pass and the image differences against an earlier replay as json
+//
+// ssr_replay [--preset low|medium|high|ultra] [--repeat N] [--threshold F] [--baseline DIR] [--write DIR]
+//            [--output FILE] [--render-system NAME] [--media DIR] [--reference|--verify [--threads N]]
+//            CAPTURES_DIR
+//
+// captures come from ssr_compositor::capture (C in the demo), the quality they were rendered with is used
+// unless --preset overrides it, --write keeps the traced colour next to each capture name for a later
+// --baseline to compare against
+// the pass marches without hi-z or dda like ssr_cpu and is timed by ssr_profiler, which needs the OpenGL 3+
+// render system, see ssr_benchmark.cpp for machines without a gpu
+// --reference traces with ssr_cpu instead, on --threads threads, and times the whole cpu trace
+// --verify traces with every simd path of ssr_cpu on 1 and --threads threads and fails on any bit that differs from
+// scalar on 1 thread
+
+static constexpr std::array<std::string_view, ssr_compositor::quality_presets_count> replay_preset_names{
+    "low",
+    "medium",
+    "high",
+    "ultra",
+};
+static constexpr std::string_view replay_extension = ".ssrcap";
+
+struct replay_options {
+    std::optional<size_t> preset{};
+    size_t repeat = 10;
+    bool reference = false;
+    bool verify = false;
+    size_t threads = 0;
+    // a pixel differs when any channel moved by more than this
+    float threshold = 1.0f / 255.0f;
+    std::string baseline{};
+    std::string write{};
+    std::string output{};
+    std::string render_system = "OpenGL 3+ Rendering Subsystem";
+    std::string media{};
+    std::string captures{};
+};
+
+struct replay_diff {
+    float rmse;
+    float max;
+    size_t pixels_differing;
+};
+
+struct replay_run {
+    std::string name;
+    unsigned width;
+    unsigned height;
+    std::vector<double> trace_ms;
+    std::optional<replay_diff> diff;
+    std::string error;
+};
+
+static bool replay_parse(int argc, char *argv[], replay_options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view option = argv[i];
+        if (!option.starts_with("--")) {
+            if (!options.captures.empty()) {
+                return false;
+            }
+            options.captures = argv[i];
+            continue;
+        }
+        if (option == "--reference") {
+            options.reference = true;
+            continue;
+        }
+        if (option == "--verify") {
+            options.verify = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = argv[++i];
+        if (option == "--preset") {
+            auto it = std::find(replay_preset_names.begin(), replay_preset_names.end(), value);
+            if (it == replay_preset_names.end()) {
+                return false;
+            }
+            options.preset = size_t(it - replay_preset_names.begin());
+        } else if (option == "--repeat") {
+            options.repeat = std::strtoul(value, nullptr, 10);
+        } else if (option == "--threads") {
+            options.threads = std::strtoul(value, nullptr, 10);
+        } else if (option == "--threshold") {
+            options.threshold = std::strtof(value, nullptr);
+        } else if (option == "--baseline") {
+            options.baseline = value;
+        } else if (option == "--write") {
+            options.write = value;
+        } else if (option == "--output") {
+            options.output = value;
+        } else if (option == "--render-system") {
+            options.render_system = value;
+        } else if (option == "--media") {
+            options.media = value;
+        } else {
+            return false;
+        }
+    }
+    return !options.captures.empty() && options.repeat != 0 && !(options.reference && options.verify);
+}
+
+static std::vector<std::filesystem::path> replay_captures(const std::string &directory) {
+    std::vector<std::filesystem::path> captures{};
+    std::error_code error{};
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == replay_extension) {
+            captures.push_back(entry.path());
+        }
+    }
+    std::sort(captures.begin(), captures.end());
+    return captures;
+}
+
+static ssr_cpu::settings replay_settings(const replay_options &options, const ssr_capture::header &header) {
+    if (options.preset) {
+        const ssr_compositor::quality_desc &quality = ssr_compositor::quality_presets[*options.preset];
+        return {
+            quality.steps_max,
+            quality.steps_bsearch_max,
+            quality.distance_max_vs,
+            quality.thickness_radius_vs,
+            quality.frustum_clip_enable,
+            quality.bsearch_enable,
+        };
+    }
+    return {
+        header.raytrace.steps_max,
+        header.raytrace.steps_bsearch_max,
+        header.raytrace.distance_max_vs,
+        header.raytrace.thickness_radius_vs,
+        header.raytrace.frustum_clip_enable != 0,
+        header.raytrace.bsearch_enable != 0,
+    };
+}
+
+// what the gpu pass needs of the settings, the hi-z steps go unused without the traversal
+static ssr_compositor::quality_desc replay_quality(const ssr_cpu::settings &settings) {
+    return {
+        settings.steps_max,
+        settings.steps_bsearch_max,
+        0,
+        settings.distance_max_vs,
+        settings.thickness_radius_vs,
+        settings.frustum_clip_enable,
+        settings.bsearch_enable,
+        false,
+        false,
+    };
+}
+
+// rgb only, the alpha of the scene colour carries nothing
+static replay_diff replay_compare(const std::vector<float> &colour, const std::vector<float> &baseline, float threshold) {
+    replay_diff diff{0.0f, 0.0f, 0};
+    double squared = 0.0;
+    const size_t pixels = colour.size() / 4;
+    for (size_t i = 0; i < pixels; ++i) {
+        float pixel_max = 0.0f;
+        for (size_t c = 0; c < 3; ++c) {
+            const float delta = std::abs(colour[i * 4 + c] - baseline[i * 4 + c]);
+            squared += double(delta) * delta;
+            pixel_max = std::max(pixel_max, delta);
+        }
+        diff.max = std::max(diff.max, pixel_max);
+        diff.pixels_differing += pixel_max > threshold;
+    }
+    diff.rmse = pixels == 0 ? 0.0f : float(std::sqrt(squared / double(pixels * 3)));
+    return diff;
+}
+
+// the capture and its inputs in the layout ssr_cpu::frame reads, false with run.error set when either is missing
+static bool replay_open(
+    const std::filesystem::path &path,
+    ssr_capture &capture,
+    std::vector<float> &ndr,
+    std::vector<float> &scene,
+    replay_run &run
+) {
+    if (!capture.open(path.string())) {
+        run.error = "not a capture";
+        return false;
+    }
+    const ssr_capture::header &header = capture.file_header();
+    run.width = header.width;
+    run.height = header.height;
+
+    ndr = capture.ndr_unpacked();
+    scene = capture.scene_colour();
+    if (ndr.empty() || scene.empty()) {
+        run.error = "missing normal_depth_rough or scene colour";
+        return false;
+    }
+    return true;
+}
+
+// compares the traced colour against the baseline and writes it with --write, hit_uv only when the trace gives one
+static void replay_finish(
+    const replay_options &options,
+    const std::filesystem::path &path,
+    const ssr_capture::header &header,
+    const ssr_cpu::settings &quality,
+    const std::vector<float> &colour,
+    const std::vector<float> &hit_uv,
+    replay_run &run
+) {
+    if (!options.baseline.empty()) {
+        ssr_capture baseline{};
+        const bool opened = baseline.open((std::filesystem::path(options.baseline) / path.filename()).string());
+        const std::vector<float> baseline_colour = opened ? baseline.colour() : std::vector<float>{};
+        if (baseline_colour.size() == colour.size()) {
+            run.diff = replay_compare(colour, baseline_colour, options.threshold);
+        } else {
+            run.error = "no matching baseline";
+        }
+    }
+    if (!options.write.empty()) {
+        ssr_capture::header written = header;
+        written.raytrace = {
+            quality.steps_max,
+            quality.steps_bsearch_max,
+            quality.distance_max_vs,
+            quality.thickness_radius_vs,
+            quality.frustum_clip_enable,
+            quality.bsearch_enable,
+        };
+        std::vector<ssr_capture::plane_data> planes{
+            {ssr_capture::plane_kind::colour, ssr_capture::plane_format::rgba32f, colour.data()},
+        };
+        if (!hit_uv.empty()) {
+            planes.push_back({ssr_capture::plane_kind::hit_uv, ssr_capture::plane_format::rgba32f, hit_uv.data()});
+        }
+        if (!ssr_capture::write((std::filesystem::path(options.write) / path.filename()).string(), written, planes)) {
+            run.error = "failed to write the replay";
+        }
+    }
+}
+
+static ssr_cpu::frame replay_frame(
+    const ssr_capture::header &header,
+    const std::vector<float> &ndr,
+    const std::vector<float> &scene
+) {
+    return {
+        header.width,
+        header.height,
+        ndr.data(),
+        scene.data(),
+        header.projection_matrix,
+        header.i_projection_matrix,
+        header.i_view_matrix,
+        header.near_clip_plane,
+        header.far_clip_plane,
+        header.raytrace_frame,
+    };
+}
+
+static replay_run replay_reference(ssr_cpu &cpu, const replay_options &options, const std::filesystem::path &path) {
+    replay_run run{path.filename().string(), 0, 0, {}, std::nullopt, {}};
+    ssr_capture capture{};
+    std::vector<float> ndr{};
+    std::vector<float> scene{};
+    if (!replay_open(path, capture, ndr, scene, run)) {
+        return run;
+    }
+    const ssr_capture::header &header = capture.file_header();
+
+    const size_t pixels = size_t(header.width) * header.height;
+    std::vector<float> colour(pixels * 4);
+    std::vector<float> hit_uv(pixels * 4);
+    const ssr_cpu::frame frame = replay_frame(header, ndr, scene);
+    cpu.quality = replay_settings(options, header);
+    for (size_t i = 0; i < options.repeat; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        cpu.trace(frame, {hit_uv.data(), colour.data()});
+        run.trace_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+    }
+    replay_finish(options, path, header, cpu.quality, colour, hit_uv, run);
+    return run;
+}
+
+// renders the raytrace of each capture into a render texture of its size, the camera of the capture
+// is written straight into ssr/constants and its planes are uploaded as the pass inputs
+// traces with every simd path on single and on many, run.error names the first that differs from scalar on single
+static replay_run replay_verify(
+    ssr_cpu &single,
+    ssr_cpu &many,
+    const replay_options &options,
+    const std::filesystem::path &path
+) {
+    replay_run run{path.filename().string(), 0, 0, {}, std::nullopt, {}};
+    ssr_capture capture{};
+    std::vector<float> ndr{};
+    std::vector<float> scene{};
+    if (!replay_open(path, capture, ndr, scene, run)) {
+        return run;
+    }
+    const ssr_capture::header &header = capture.file_header();
+
+    const size_t pixels = size_t(header.width) * header.height;
+    const ssr_cpu::frame frame = replay_frame(header, ndr, scene);
+    auto trace = [&](ssr_cpu &cpu, const ssr_cpu::simd_path *simd, std::vector<float> &colour,
+                     std::vector<float> &hit_uv) {
+        colour.assign(pixels * 4, 0.0f);
+        hit_uv.assign(pixels * 4, 0.0f);
+        cpu.quality = replay_settings(options, header);
+        cpu.simd = simd;
+        cpu.trace(frame, {hit_uv.data(), colour.data()});
+    };
+
+    // scalar is the last path
+    const std::vector<const ssr_cpu::simd_path *> &paths = ssr_cpu::simd_paths();
+    std::vector<float> colour{};
+    std::vector<float> hit_uv{};
+    trace(single, paths.back(), colour, hit_uv);
+    for (auto it = paths.rbegin(); it != paths.rend() && run.error.empty(); ++it) {
+        for (ssr_cpu *cpu : {&single, &many}) {
+            std::vector<float> traced_colour{};
+            std::vector<float> traced_hit_uv{};
+            trace(*cpu, *it, traced_colour, traced_hit_uv);
+            size_t differing = 0;
+            for (size_t i = 0; i < pixels * 4; i += 4) {
+                const bool same = std::memcmp(&colour[i], &traced_colour[i], 4 * sizeof(float)) == 0
+                    && std::memcmp(&hit_uv[i], &traced_hit_uv[i], 4 * sizeof(float)) == 0;
+                differing += same ? 0 : 1;
+            }
+            if (differing != 0) {
+                const std::string threads = cpu == &single ? "1 thread"
+                    : options.threads == 0 ? "every thread" : std::to_string(options.threads) + " threads";
+                run.error = std::string((*it)->name) + " on " + threads + " differs from scalar on 1 thread in "
+                    + std::to_string(differing) + " pixels";
+                break;
+            }
+        }
+    }
+    return run;
+}
+
+struct ssr_replay : public OgreBites::ApplicationContext {
+    static inline const std::string compositor_name = "ssr_replay";
+
+    replay_options options;
+    Ogre::SceneManager *scene_manager = nullptr;
+    Ogre::Camera *camera = nullptr;
+
+    explicit ssr_replay(replay_options options) :
+        OgreBites::ApplicationContext("ssr_replay"),
+        options{std::move(options)} { }
+
+    bool oneTimeConfig() override {
+        Ogre::RenderSystem *render_system = mRoot->getRenderSystemByName(options.render_system);
+        if (render_system == nullptr) {
+            return false;
+        }
+        mRoot->setRenderSystem(render_system);
+        return true;
+    }
+    // the window only provides the context, the pass renders into a render texture
+    OgreBites::NativeWindowPair createWindow(
+        const Ogre::String &name,
+        Ogre::uint32 w,
+        Ogre::uint32 h,
+        Ogre::NameValuePairList miscParams
+    ) override {
+        (void)w;
+        (void)h;
+        miscParams["hidden"] = "true";
+        OgreBites::NativeWindowPair window = OgreBites::ApplicationContextBase::createWindow(name, 1, 1, miscParams);
+        window.render->setAutoUpdated(false);
+        return window;
+    }
+    void pollEvents() override { }
+    void locateResources() override {
+        OgreBites::ApplicationContext::locateResources();
+        if (!options.media.empty()) {
+            auto &resource_manager = Ogre::ResourceGroupManager::getSingleton();
+            resource_manager.addResourceLocation(options.media, "FileSystem", Ogre::RGN_DEFAULT);
+            resource_manager.addResourceLocation(options.media + "/ssr", "FileSystem", Ogre::RGN_DEFAULT);
+        }
+    }
+
+    void setup() override {
+        OgreBites::ApplicationContext::setup();
+        // nothing is drawn but the quad, the camera only feeds the clip distances to the pass
+        scene_manager = mRoot->createSceneManager();
+        camera = scene_manager->createCamera("ReplayCam");
+        scene_manager->getRootSceneNode()->attachObject(camera);
+    }
+    void shutdown() override {
+        if (scene_manager != nullptr) {
+            mRoot->destroySceneManager(scene_manager);
+            scene_manager = nullptr;
+        }
+        OgreBites::ApplicationContext::shutdown();
+    }
+
+    static void write_constants(const ssr_capture::header &header) {
+        const Ogre::GpuSharedParametersPtr constants =
+            Ogre::GpuProgramManager::getSingleton().getSharedParameters(ssr_logic::constants_name);
+        constants->setNamedConstant("raytrace_projection_matrix", header.projection_matrix.data(), 16);
+        constants->setNamedConstant("raytrace_i_projection_matrix", header.i_projection_matrix.data(), 16);
+        constants->setNamedConstant("raytrace_i_view_matrix", header.i_view_matrix.data(), 16);
+        constants->setNamedConstant("raytrace_render_scale", Ogre::Vector4(1.0f));
+        constants->setNamedConstant("raytrace_frame", int(header.raytrace_frame));
+    }
+
+    replay_run trace(const std::filesystem::path &path) {
+        replay_run run{path.filename().string(), 0, 0, {}, std::nullopt, {}};
+        ssr_capture capture{};
+        std::vector<float> ndr{};
+        std::vector<float> scene{};
+        if (!replay_open(path, capture, ndr, scene, run)) {
+            return run;
+        }
+        const ssr_capture::header &header = capture.file_header();
+        const ssr_cpu::settings quality = replay_settings(options, header);
+
+        auto &texture_manager = Ogre::TextureManager::getSingleton();
+        auto &material_manager = Ogre::MaterialManager::getSingleton();
+        auto &composer = Ogre::CompositorManager::getSingleton();
+        auto create_texture = [&](const std::string &name, int usage) {
+            return texture_manager.createManual(
+                name,
+                Ogre::RGN_DEFAULT,
+                Ogre::TEX_TYPE_2D,
+                header.width,
+                header.height,
+                0,
+                Ogre::PF_FLOAT32_RGBA,
+                usage
+            );
+        };
+        auto upload = [&](const std::string &name, std::vector<float> &texels) {
+            Ogre::TexturePtr texture = create_texture(name, Ogre::TU_STATIC_WRITE_ONLY);
+            texture->getBuffer()->blitFromMemory(
+                Ogre::PixelBox(header.width, header.height, 1, Ogre::PF_FLOAT32_RGBA, texels.data())
+            );
+            return texture;
+        };
+        Ogre::TexturePtr scene_texture = upload("ssr_replay/scene_colour", scene);
+        Ogre::TexturePtr ndr_texture = upload("ssr_replay/normal_depth_rough", ndr);
+        Ogre::TexturePtr target_texture = create_texture("ssr_replay/colour", Ogre::TU_RENDERTARGET);
+        Ogre::RenderTexture &target = *target_texture->getBuffer()->getRenderTarget();
+        camera->setNearClipDistance(header.near_clip_plane);
+        camera->setFarClipDistance(header.far_clip_plane);
+        Ogre::Viewport &viewport = *target.addViewport(camera);
+
+        Ogre::MaterialPtr material = ssr_compositor::reference_raytrace_material(replay_quality(quality))
+            ->clone("ssr_replay/raytrace");
+        Ogre::Pass &material_pass = *material->getTechnique(0)->getPass(0);
+        material_pass.getTextureUnitState(0)->setTexture(scene_texture);
+        material_pass.getTextureUnitState(1)->setTexture(ndr_texture);
+        material->load();
+        write_constants(header);
+
+        ssr_profiler profiler{};
+        Ogre::CompositorPtr compositor = composer.create(compositor_name, Ogre::RGN_DEFAULT); {
+            Ogre::CompositionTechnique &technique = *compositor->createTechnique();
+            Ogre::CompositionTargetPass &output = *technique.getOutputTargetPass();
+            output.setInputMode(Ogre::CompositionTargetPass::IM_NONE);
+            Ogre::CompositionPass *begin = output.createPass(Ogre::CompositionPass::PT_RENDERCUSTOM);
+            begin->setCustomType(ssr_profiler::custom_type_prefix + "raytrace");
+            begin->setIdentifier(ssr_profiler::timestamp_begin);
+            output.createPass(Ogre::CompositionPass::PT_RENDERQUAD)->setMaterial(material);
+            Ogre::CompositionPass *end = output.createPass(Ogre::CompositionPass::PT_RENDERCUSTOM);
+            end->setCustomType(ssr_profiler::custom_type_prefix + "raytrace");
+            end->setIdentifier(ssr_profiler::timestamp_end);
+            profiler.attach(composer, technique);
+        }
+        composer.addCompositor(&viewport, compositor_name);
+        composer.setCompositorEnabled(&viewport, compositor_name, true);
+
+        // the timestamps of a frame are read back queries_latency frames later
+        for (size_t frame = 0; frame < options.repeat + ssr_profiler::queries_latency; ++frame) {
+            mRoot->renderOneFrame();
+            profiler.frame_ended();
+        }
+        const ssr_profiler::stage &stage = profiler.stage_named(compositor_name + "/raytrace");
+        const size_t samples = std::min({stage.gpu_samples, options.repeat, ssr_profiler::window_size});
+        for (size_t i = stage.gpu_samples - samples; i < stage.gpu_samples; ++i) {
+            run.trace_ms.push_back(stage.gpu_ms[i % ssr_profiler::window_size]);
+        }
+
+        std::vector<float> colour(size_t(header.width) * header.height * 4);
+        target_texture->getBuffer()->blitToMemory(
+            Ogre::PixelBox(header.width, header.height, 1, Ogre::PF_FLOAT32_RGBA, colour.data())
+        );
+
+        composer.removeCompositor(&viewport, compositor_name);
+        composer.remove(compositor);
+        profiler.detach(composer);
+        target.removeAllViewports();
+        material_manager.remove(material);
+        texture_manager.remove(target_texture);
+        texture_manager.remove(ndr_texture);
+        texture_manager.remove(scene_texture);
+
+        if (run.trace_ms.empty()) {
+            run.error = "no gpu timestamps, the OpenGL 3+ render system takes them";
+            return run;
+        }
+        replay_finish(options, path, header, quality, colour, {}, run);
+        return run;
+    }
+};
+
+static void replay_write_json(std::ostream &out, const replay_options &options, const std::vector<replay_run> &runs) {
+    out << "{\n";
+    if (options.reference) {
+        out << "  \"mode\": \"reference\",\n";
+        out << "  \"simd\": \"" << ssr_cpu::simd_paths().front()->name << "\",\n";
+    } else if (options.verify) {
+        out << "  \"mode\": \"verify\",\n";
+        out << "  \"simd\": [";
+        const std::vector<const ssr_cpu::simd_path *> &paths = ssr_cpu::simd_paths();
+        for (size_t p = 0; p < paths.size(); ++p) {
+            out << (p == 0 ? "\"" : ", \"") << paths[p]->name << "\"";
+        }
+        out << "],\n";
+    } else {
+        out << "  \"mode\": \"gpu\",\n";
+        out << "  \"render_system\": \"" << options.render_system << "\",\n";
+    }
+    out << "  \"repeat\": " << options.repeat << ",\n";
+    out << "  \"preset\": ";
+    if (options.preset) {
+        out << "\"" << replay_preset_names[*options.preset] << "\",\n";
+    } else {
+        out << "null,\n";
+    }
+    out << "  \"captures\": [";
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const replay_run &run = runs[r];
+        out << (r == 0 ? "\n" : ",\n");
+        out << "    {\n";
+        out << "      \"name\": \"" << run.name << "\",\n";
+        out << "      \"width\": " << run.width << ",\n";
+        out << "      \"height\": " << run.height << ",\n";
+        if (!run.trace_ms.empty()) {
+            std::vector<double> sorted = run.trace_ms;
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (const double value : sorted) {
+                sum += value;
+            }
+            out << "      \"trace_ms\": {\"min\": " << sorted.front()
+                << ", \"avg\": " << sum / double(sorted.size())
+                << ", \"p50\": " << sorted[sorted.size() / 2]
+                << ", \"max\": " << sorted.back() << "},\n";
+        }
+        if (run.diff) {
+            out << "      \"diff\": {\"rmse\": " << run.diff->rmse
+                << ", \"max\": " << run.diff->max
+                << ", \"pixels_differing\": " << run.diff->pixels_differing << "},\n";
+        }
+        out << "      \"error\": ";
+        if (run.error.empty()) {
+            out << "null\n";
+        } else {
+            out << "\"" << run.error << "\"\n";
+        }
+        out << "    }";
+    }
+    out << (runs.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+}
+
+int main(int argc, char *argv[]) {
+    replay_options options{};
+    if (!replay_parse(argc, argv, options)) {
+        std::cerr
+            << "usage: ssr_replay [--preset low|medium|high|ultra] [--repeat N] [--threshold F] [--baseline DIR]\n"
+            << "                  [--write DIR] [--output FILE] [--render-system NAME] [--media DIR]\n"
+            << "                  [--reference|--verify [--threads N]] CAPTURES_DIR\n";
+        return 2;
+    }
+    const std::vector<std::filesystem::path> captures = replay_captures(options.captures);
+    if (captures.empty()) {
+        std::cerr << "ssr_replay: no " << replay_extension << " files in " << options.captures << "\n";
+        return 1;
+    }
+    if (!options.write.empty()) {
+        std::error_code error{};
+        std::filesystem::create_directories(options.write, error);
+    }
+
+    std::vector<replay_run> runs{};
+    if (options.reference) {
+        ssr_cpu cpu{options.threads};
+        for (const auto &path : captures) {
+            runs.push_back(replay_reference(cpu, options, path));
+        }
+    } else if (options.verify) {
+        ssr_cpu single{1};
+        ssr_cpu many{options.threads};
+        for (const auto &path : captures) {
+            runs.push_back(replay_verify(single, many, options, path));
+        }
+    } else {
+        ssr_replay app{options};
+        app.initApp();
+        if (app.getRoot()->getRenderSystem() == nullptr) {
+            std::cerr << "ssr_replay: render system \"" << options.render_system << "\" is not available\n";
+            app.closeApp();
+            return 1;
+        }
+        for (const auto &path : captures) {
+            runs.push_back(app.trace(path));
+        }
+        app.closeApp();
+    }
+
+    if (options.output.empty()) {
+        replay_write_json(std::cout, options, runs);
+    } else {
+        std::ofstream out{options.output};
+        replay_write_json(out, options, runs);
+    }
+    const bool failed = std::any_of(runs.begin(), runs.end(), [](const replay_run &run) { return !run.error.empty(); });
+    return failed ? 1 : 0;
+}
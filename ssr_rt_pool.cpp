@@ -0,0 +1,175 @@
+#include "ssr_rt_pool.hpp"
+#include <OgreCompositionTargetPass.h>
+#include <OgreCompositionPass.h>
+#include <OgrePixelFormat.h>
+#include <OgreTexture.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+
+static bool ssr_rt_pool_compatible(
+    const Ogre::TextureDefinition &lhs,
+    const Ogre::TextureDefinition &rhs
+) {
+    return lhs.type == rhs.type
+        && lhs.width == rhs.width
+        && lhs.height == rhs.height
+        && lhs.widthFactor == rhs.widthFactor
+        && lhs.heightFactor == rhs.heightFactor
+        && lhs.formatList == rhs.formatList
+        && lhs.fsaa == rhs.fsaa
+        && lhs.hwGammaWrite == rhs.hwGammaWrite
+        && lhs.depthBufferId == rhs.depthBufferId
+        && lhs.scope == rhs.scope;
+}
+
+// target passes in execution order, the output target pass last
+static std::vector<Ogre::CompositionTargetPass *> ssr_rt_pool_target_passes(Ogre::CompositionTechnique &technique) {
+    std::vector<Ogre::CompositionTargetPass *> target_passes{
+        technique.getTargetPasses().begin(),
+        technique.getTargetPasses().end()
+    };
+    target_passes.push_back(technique.getOutputTargetPass());
+    return target_passes;
+}
+
+static std::vector<ssr_rt_pool::target> ssr_rt_pool_lifetimes(Ogre::CompositionTechnique &technique) {
+    std::vector<ssr_rt_pool::target> lifetimes{};
+    auto find = [&lifetimes](const std::string &name) -> ssr_rt_pool::target * {
+        auto it = std::find_if(lifetimes.begin(), lifetimes.end(), [&name](const auto &lifetime) {
+            return lifetime.name == name;
+        });
+        return it == lifetimes.end() ? nullptr : &*it;
+    };
+    for (const Ogre::TextureDefinition *definition : technique.getTextureDefinitions()) {
+        // only local targets belong to this technique alone
+        const bool persistent = definition->scope != Ogre::CompositionTechnique::TS_LOCAL;
+        lifetimes.push_back({definition->name, {definition->name}, SIZE_MAX, 0, persistent});
+    }
+
+    const auto target_passes = ssr_rt_pool_target_passes(technique);
+    for (size_t index = 0; index < target_passes.size(); ++index) {
+        const Ogre::CompositionTargetPass &target_pass = *target_passes[index];
+        for (const Ogre::CompositionPass *pass : target_pass.getPasses()) {
+            for (size_t input = 0; input < pass->getNumInputs(); ++input) {
+                ssr_rt_pool::target *lifetime = find(pass->getInput(input).name);
+                if (lifetime == nullptr) {
+                    continue;
+                }
+                // read before anything wrote it this frame, the contents carry over from the previous one
+                lifetime->persistent |= lifetime->first_use == SIZE_MAX;
+                lifetime->last_use = std::max(lifetime->last_use, index);
+            }
+        }
+        if (ssr_rt_pool::target *lifetime = find(target_pass.getOutputName())) {
+            lifetime->persistent |= target_pass.getOnlyInitial();
+            lifetime->first_use = std::min(lifetime->first_use, index);
+            lifetime->last_use = std::max(lifetime->last_use, index);
+        }
+    }
+    return lifetimes;
+}
+
+void ssr_rt_pool::allocate(const std::string &compositor_name, Ogre::CompositionTechnique &technique) {
+    std::vector<target> lifetimes = ssr_rt_pool_lifetimes(technique);
+    std::stable_sort(lifetimes.begin(), lifetimes.end(), [](const target &lhs, const target &rhs) {
+        return lhs.first_use < rhs.first_use;
+    });
+
+    auto definition_of = [&technique](const std::string &name) {
+        return technique.getTextureDefinition(name);
+    };
+
+    // greedy interval assignment: a target takes over the first compatible one that is done before it starts
+    std::vector<target> &physical = targets[compositor_name];
+    physical.clear();
+    std::unordered_map<std::string, std::string> aliases{};
+    for (const target &lifetime : lifetimes) {
+        auto slot = std::find_if(physical.begin(), physical.end(), [&](const target &candidate) {
+            return !candidate.persistent
+                && !lifetime.persistent
+                && candidate.last_use < lifetime.first_use
+                && ssr_rt_pool_compatible(*definition_of(candidate.name), *definition_of(lifetime.name));
+        });
+        if (slot == physical.end()) {
+            physical.push_back(lifetime);
+            continue;
+        }
+        slot->logical_names.push_back(lifetime.name);
+        slot->last_use = lifetime.last_use;
+        aliases[lifetime.name] = slot->name;
+    }
+
+    for (Ogre::CompositionTargetPass *target_pass : ssr_rt_pool_target_passes(technique)) {
+        if (auto it = aliases.find(target_pass->getOutputName()); it != aliases.end()) {
+            target_pass->setOutputName(it->second);
+        }
+        for (Ogre::CompositionPass *pass : target_pass->getPasses()) {
+            for (size_t input = 0; input < pass->getNumInputs(); ++input) {
+                const Ogre::CompositionPass::InputTex &input_texture = pass->getInput(input);
+                if (auto it = aliases.find(input_texture.name); it != aliases.end()) {
+                    pass->setInput(input, it->second, input_texture.mrtIndex);
+                }
+            }
+        }
+    }
+    for (const auto &[logical_name, physical_name] : aliases) {
+        (void)physical_name;
+        const auto &definitions = technique.getTextureDefinitions();
+        for (size_t index = 0; index < definitions.size(); ++index) {
+            if (definitions[index]->name == logical_name) {
+                technique.removeTextureDefinition(index);
+                break;
+            }
+        }
+    }
+
+    // the pipelines are alternatives, pooled definitions let them and the other viewports share the
+    // allocations, persistent ones keep their contents to each instance
+    for (const target &slot : physical) {
+        definition_of(slot.name)->pooled = !slot.persistent;
+    }
+}
+
+void ssr_rt_pool::clear() {
+    targets.clear();
+}
+
+const std::string &ssr_rt_pool::physical_name(const std::string &compositor_name, const std::string &logical_name) const {
+    auto it = targets.find(compositor_name);
+    if (it == targets.end()) {
+        return logical_name;
+    }
+    for (const target &slot : it->second) {
+        if (std::find(slot.logical_names.begin(), slot.logical_names.end(), logical_name) != slot.logical_names.end()) {
+            return slot.name;
+        }
+    }
+    return logical_name;
+}
+
+size_t ssr_rt_pool::vram_bytes(const std::vector<Ogre::CompositorInstance *> &instances) {
+    std::unordered_set<const Ogre::Texture *> counted{};
+    size_t bytes = 0;
+    for (Ogre::CompositorInstance *instance : instances) {
+        if (!instance->getEnabled()) {
+            continue;
+        }
+        for (const Ogre::TextureDefinition *definition : instance->getTechnique()->getTextureDefinitions()) {
+            for (size_t plane = 0; plane < definition->formatList.size(); ++plane) {
+                const Ogre::TexturePtr texture = instance->getTextureInstance(definition->name, plane);
+                if (!texture || !counted.insert(texture.get()).second) {
+                    continue;
+                }
+                bytes += Ogre::PixelUtil::getMemorySize(
+                    texture->getWidth(),
+                    texture->getHeight(),
+                    texture->getDepth(),
+                    texture->getFormat()
+                ) * std::max(texture->getFSAA(), 1u);
+            }
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,39 @@
+#ifndef SSR_RT_POOL_HPP
+#define SSR_RT_POOL_HPP
+
+#include <OgreCompositionTechnique.h>
+#include <OgreCompositorInstance.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// render targets of the ssr pipelines, one allocation per physical target
+// logical targets of a technique whose lifetimes within the frame don't overlap share one texture
+// definition, the definitions left are pooled by the compositor manager across the alternative pipelines
+// and across viewports of the same size, whose chains render one after the other
+struct ssr_rt_pool {
+    struct target {
+        // texture definition the logical targets were aliased onto
+        std::string name;
+        std::vector<std::string> logical_names;
+        // target pass indices of the first write and the last read, persistent targets live the whole frame
+        size_t first_use;
+        size_t last_use;
+        bool persistent;
+    };
+    // physical targets of every technique allocated through the pool, keyed by compositor name
+    std::unordered_map<std::string, std::vector<target>> targets{};
+
+    // aliases then pools the texture definitions of technique, rewriting the target passes
+    // and pass inputs that referenced an aliased logical target
+    void allocate(const std::string &compositor_name, Ogre::CompositionTechnique &technique);
+    void clear();
+    // texture definition holding logical_name in the technique allocated as compositor_name
+    const std::string &physical_name(const std::string &compositor_name, const std::string &logical_name) const;
+
+    // bytes of the distinct textures the created instances hold
+    static size_t vram_bytes(const std::vector<Ogre::CompositorInstance *> &instances);
+};
+
+#endif